@@ -1,4 +1,5 @@
 #include <flon.bios/flon.bios.hpp>
+#include <flon.system/bls_pop.hpp>
 #include <eosio/crypto_bls_ext.hpp>
 
 #include <unordered_set>
@@ -50,6 +51,12 @@ void bios::setfinalizer( const finalizer_policy& finalizer_policy ) {
    };
    std::unordered_set<eosio::bls_g1, g1_hash, g1_equal> unique_finalizer_keys;
 
+   // proofs of possession are verified together after all keys are decoded
+   std::vector<eosio::bls_g1> public_keys;
+   std::vector<eosio::bls_g2> signatures;
+   public_keys.reserve(finalizer_policy.finalizers.size());
+   signatures.reserve(finalizer_policy.finalizers.size());
+
    uint64_t weight_sum = 0;
 
    for (const auto& f: finalizer_policy.finalizers) {
@@ -69,15 +76,16 @@ void bios::setfinalizer( const finalizer_policy& finalizer_policy ) {
       // duplicate key check
       check(unique_finalizer_keys.insert(pk).second, "duplicate public key");
 
-      const auto signature = eosio::decode_bls_signature_to_g2(f.pop);
-
-      // proof of possession of private key check
-      check(eosio::bls_pop_verify(pk, signature), "proof of possession failed");
+      signatures.emplace_back(eosio::decode_bls_signature_to_g2(f.pop));
+      public_keys.emplace_back(pk);
 
       std::vector<char> pk_vector(pk.begin(), pk.end());
       fin_policy.finalizers.emplace_back(eosio::finalizer_authority{f.description, f.weight, std::move(pk_vector)});
    }
 
+   // proof of possession of private keys check
+   check(eosiosystem::bls_pop_verify_batch(public_keys, signatures), "proof of possession failed");
+
    check( weight_sum >= finalizer_policy.threshold && finalizer_policy.threshold > weight_sum / 2,
           "Finalizer policy threshold must be greater than half of the sum of the weights, and less than or equal to the sum of the weights");
 
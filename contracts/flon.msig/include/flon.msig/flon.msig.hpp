@@ -19,6 +19,9 @@ namespace eosio {
       public:
          using contract::contract;
 
+         /// The most proposals one `sweep` erases, so that a call always fits in a transaction
+         static constexpr uint32_t max_sweep_count = 100;
+
          /**
           * Propose action, creates a proposal containing one transaction.
           * Allows an account `proposer` to make a proposal `proposal_name` which has `requested`
@@ -29,6 +32,9 @@ namespace eosio {
           * already exist; if all validations pass the `proposal_name` and `trx` trasanction are
           * saved in the proposals table and the `requested` permission levels to the
           * approvals table (for the `proposer` context). Storage changes are billed to `proposer`.
+          * The transaction is stored once in the packed transactions table, keyed by its sha256, and
+          * the proposal keeps only that hash with an empty `packed_transaction`; `getproposal`
+          * returns the transaction of any proposal.
           *
           * @param proposer - The account proposing a transaction
           * @param proposal_name - The name of the proposal (should be unique for proposer)
@@ -105,17 +111,72 @@ namespace eosio {
          [[eosio::action]]
          void invalidate( name account );
 
+         /**
+          * Sweep action erases up to `max_count` expired proposals, oldest first, together with their
+          * approvals, refunding the RAM of their proposers. Anyone may call it.
+          * `max_count` is clamped to `max_sweep_count`.
+          * Proposals made before the expirations table existed are not seen, `cancel` them instead.
+          *
+          * @param max_count - The maximum number of proposals to erase, at most `max_sweep_count`
+          *
+          * @return the expiration of the next proposal left in the expirations table, zero if it is empty;
+          * call again while it is in the past.
+          */
+         [[eosio::action]]
+         time_point_sec sweep( uint32_t max_count );
+
+         struct pending_proposal {
+            uint64_t    id;
+            name        proposer;
+            name        proposal_name;
+         };
+
+         /**
+          * Getpending action returns the proposals still waiting for the approval of `level`, oldest first.
+          * It reads the pending approvals table of `level.actor` only, no proposer scope is visited.
+          *
+          * @param level - Permission level whose approval is requested
+          * @param lower_bound - The lowest `id` to return, `id` of the last returned proposal plus one for the next page
+          * @param limit - The maximum number of proposals to return
+          *
+          * @return the pending proposals with `id` at least `lower_bound`
+          */
+         [[eosio::action, eosio::read_only]]
+         std::vector<pending_proposal> getpending( permission_level level, uint64_t lower_bound, uint32_t limit );
+
+         /**
+          * Getproposal action returns the packed transaction of a proposal, read from the packed
+          * transactions table, or from the proposal itself for proposals made before that table existed.
+          *
+          * @param proposer - The account proposing a transaction
+          * @param proposal_name - The name of the proposal (should be an existing proposal)
+          *
+          * @return the packed transaction proposed
+          */
+         [[eosio::action, eosio::read_only]]
+         std::vector<char> getproposal( name proposer, name proposal_name );
+
          using propose_action = eosio::action_wrapper<"propose"_n, &multisig::propose>;
          using approve_action = eosio::action_wrapper<"approve"_n, &multisig::approve>;
          using unapprove_action = eosio::action_wrapper<"unapprove"_n, &multisig::unapprove>;
          using cancel_action = eosio::action_wrapper<"cancel"_n, &multisig::cancel>;
          using exec_action = eosio::action_wrapper<"exec"_n, &multisig::exec>;
          using invalidate_action = eosio::action_wrapper<"invalidate"_n, &multisig::invalidate>;
+         using sweep_action = eosio::action_wrapper<"sweep"_n, &multisig::sweep>;
+         using getpending_action = eosio::action_wrapper<"getpending"_n, &multisig::getpending>;
+         using getproposal_action = eosio::action_wrapper<"getproposal"_n, &multisig::getproposal>;
 
    struct [[eosio::table, eosio::contract("flon.msig")]] proposal {
       name                                                            proposal_name;
       std::vector<char>                                               packed_transaction;
       eosio::binary_extension< std::optional<time_point> >            earliest_exec_time;
+      //header of packed_transaction, decoded once by propose
+      eosio::binary_extension< transaction_header >                   trx_header;
+      //primary key of the proposal in the expirations table
+      eosio::binary_extension< uint64_t >                             expiration_id;
+      //sha256 of the transaction kept in the packed transactions table, packed_transaction is left empty,
+      //read the transaction with getproposal
+      eosio::binary_extension< eosio::checksum256 >                   trx_hash;
 
       uint64_t primary_key()const { return proposal_name.value; }
    };
@@ -134,6 +195,9 @@ namespace eosio {
       //doesn't change serialized data size. So, we use the same type.
       std::vector<approval>   requested_approvals;
       std::vector<approval>   provided_approvals;
+      //invalidation epoch at which all provided approvals were last found valid, the
+      //invalidations table need not be searched again until another account invalidates
+      eosio::binary_extension<uint64_t> valid_epoch;
       uint64_t primary_key()const { return proposal_name.value; }
    };
    typedef eosio::multi_index< "approvals"_n, approvals_info > approvals;
@@ -146,5 +210,65 @@ namespace eosio {
       };
 
       typedef eosio::multi_index< "invals"_n, invalidation > invalidations;
+
+   //single row counting the invalidate actions
+   struct [[eosio::table, eosio::contract("flon.msig")]] invalidation_epoch {
+         uint64_t     epoch = 0;
+
+         uint64_t primary_key() const { return 0; }
+      };
+
+      typedef eosio::multi_index< "invalepoch"_n, invalidation_epoch > invalidation_epochs;
+
+   struct proposal_ref {
+         name                 proposer;
+         name                 proposal_name;
+      };
+
+   //packed transactions of the proposals, stored once with the proposals referencing them;
+   //the RAM is billed to the proposer of the last reference, the previous one pays again when it is released
+   struct [[eosio::table, eosio::contract("flon.msig")]] packed_trx {
+         uint64_t                   id;
+         checksum256                trx_hash;
+         std::vector<char>          packed_transaction;
+         std::vector<proposal_ref>  refs;
+
+         uint64_t primary_key() const { return id; }
+         checksum256 by_hash() const { return trx_hash; }
+      };
+
+      typedef eosio::multi_index< "packedtrxs"_n, packed_trx,
+         indexed_by<"byhash"_n, const_mem_fun<packed_trx, checksum256, &packed_trx::by_hash>>
+      > packed_trxs;
+
+   //proposals ordered by expiration, for sweep
+   struct [[eosio::table, eosio::contract("flon.msig")]] proposal_expiration {
+         uint64_t             id;
+         name                 proposer;
+         name                 proposal_name;
+         time_point_sec       expiration;
+
+         uint64_t primary_key() const { return id; }
+         uint64_t by_expiration() const { return expiration.sec_since_epoch(); }
+      };
+
+      typedef eosio::multi_index< "expirations"_n, proposal_expiration,
+         indexed_by<"byexpiration"_n, const_mem_fun<proposal_expiration, uint64_t, &proposal_expiration::by_expiration>>
+      > proposal_expirations;
+
+   //requested approvals not yet provided, scoped by the approving account
+   struct [[eosio::table, eosio::contract("flon.msig")]] pending_approval {
+         uint64_t             id;
+         name                 proposer;
+         name                 proposal_name;
+         std::vector<name>    permissions;
+
+         uint64_t primary_key() const { return id; }
+         uint128_t by_proposal() const { return (uint128_t(proposer.value) << 64) | proposal_name.value; }
+      };
+
+      typedef eosio::multi_index< "pendingappr"_n, pending_approval,
+         indexed_by<"byproposal"_n, const_mem_fun<pending_approval, uint128_t, &pending_approval::by_proposal>>
+      > pending_approvals;
    };
 } /// namespace eosio
@@ -18,26 +18,162 @@ DEFINE_VERSION_CONTRACT_CLASS("flon.msig", multisig)
 transaction_header get_trx_header(const char* ptr, size_t sz);
 bool trx_is_authorized(const std::vector<permission_level>& approvals, const std::vector<char>& packed_trx);
 
+uint64_t get_invalidation_epoch(name self) {
+   multisig::invalidation_epochs epoch_table( self, self.value );
+   auto it = epoch_table.find( 0 );
+   return it == epoch_table.end() ? 0 : it->epoch;
+}
+
+// The invalidations table is only searched when an account invalidated its approvals since all provided
+// approvals were last found valid. `table_op` receives the current epoch when none was filtered out.
 template<typename Function>
 std::vector<permission_level> get_approvals_and_adjust_table(name self, name proposer, name proposal_name, Function&& table_op) {
    multisig::approvals approval_table( self, proposer.value );
    auto approval_table_iter = approval_table.find( proposal_name.value );
    std::vector<permission_level> approvals_vector;
-   multisig::invalidations invalidations_table( self, self.value );
 
    if ( approval_table_iter != approval_table.end() ) {
-      approvals_vector.reserve( approval_table_iter->provided_approvals.size() );
-      for ( const auto& permission : approval_table_iter->provided_approvals ) {
-         auto iter = invalidations_table.find( permission.level.actor.value );
-         if ( iter == invalidations_table.end() || iter->last_invalidation_time < permission.time ) {
+      const auto& provided_approvals = approval_table_iter->provided_approvals;
+      const uint64_t epoch = get_invalidation_epoch( self );
+      approvals_vector.reserve( provided_approvals.size() );
+      if ( approval_table_iter->valid_epoch.has_value() && approval_table_iter->valid_epoch.value() == epoch ) {
+         for ( const auto& permission : provided_approvals ) {
             approvals_vector.push_back(permission.level);
          }
+      } else {
+         multisig::invalidations invalidations_table( self, self.value );
+         for ( const auto& permission : provided_approvals ) {
+            auto iter = invalidations_table.find( permission.level.actor.value );
+            if ( iter == invalidations_table.end() || iter->last_invalidation_time < permission.time ) {
+               approvals_vector.push_back(permission.level);
+            }
+         }
       }
-      table_op( approval_table, approval_table_iter );
+      std::optional<uint64_t> valid_epoch;
+      if ( approvals_vector.size() == provided_approvals.size() ) {
+         valid_epoch = epoch;
+      }
+      table_op( approval_table, approval_table_iter, valid_epoch );
    }
    return approvals_vector;
 }
 
+// Records the epoch at which all provided approvals were found valid
+auto record_valid_epoch(name proposer) {
+   return [proposer](auto&& table, auto&& table_iter, const std::optional<uint64_t>& valid_epoch) {
+      if ( valid_epoch && !(table_iter->valid_epoch.has_value() && table_iter->valid_epoch.value() == *valid_epoch) ) {
+         table.modify( table_iter, proposer, [&]( auto& a ) {
+               a.valid_epoch.emplace( *valid_epoch );
+            });
+      }
+   };
+}
+
+void add_pending_approval(name self, name proposer, name proposal_name, const permission_level& level) {
+   multisig::pending_approvals pending_table( self, level.actor.value );
+   auto idx = pending_table.get_index<"byproposal"_n>();
+   auto it = idx.find( (uint128_t(proposer.value) << 64) | proposal_name.value );
+   if ( it == idx.end() ) {
+      pending_table.emplace( proposer, [&]( auto& p ) {
+            p.id            = pending_table.available_primary_key();
+            p.proposer      = proposer;
+            p.proposal_name = proposal_name;
+            p.permissions.push_back( level.permission );
+         });
+   } else {
+      idx.modify( it, proposer, [&]( auto& p ) {
+            p.permissions.push_back( level.permission );
+         });
+   }
+}
+
+// Proposals made before the pending approvals table existed have no rows in it
+void remove_pending_approval(name self, name proposer, name proposal_name, const permission_level& level) {
+   multisig::pending_approvals pending_table( self, level.actor.value );
+   auto idx = pending_table.get_index<"byproposal"_n>();
+   auto it = idx.find( (uint128_t(proposer.value) << 64) | proposal_name.value );
+   if ( it == idx.end() ) {
+      return;
+   }
+   auto perm_it = std::find( it->permissions.begin(), it->permissions.end(), level.permission );
+   if ( perm_it == it->permissions.end() ) {
+      return;
+   }
+   if ( it->permissions.size() == 1 ) {
+      idx.erase( it );
+   } else {
+      idx.modify( it, same_payer, [&]( auto& p ) {
+            p.permissions.erase( p.permissions.begin() + (perm_it - it->permissions.begin()) );
+         });
+   }
+}
+
+// The approvals of the proposal and its rows in the pending approvals table
+void erase_approvals(name self, name proposer, name proposal_name) {
+   multisig::approvals apptable( self, proposer.value );
+   auto apps_it = apptable.find( proposal_name.value );
+   if ( apps_it != apptable.end() ) {
+      for ( const auto& a : apps_it->requested_approvals ) {
+         remove_pending_approval( self, proposer, proposal_name, a.level );
+      }
+      apptable.erase(apps_it);
+   }
+}
+
+void erase_expiration(name self, const multisig::proposal& prop) {
+   if ( prop.expiration_id.has_value() ) {
+      multisig::proposal_expirations exptable( self, self.value );
+      auto it = exptable.find( prop.expiration_id.value() );
+      if ( it != exptable.end() ) {
+         exptable.erase( it );
+      }
+   }
+}
+
+// Proposals made before the packed transactions table existed keep their transaction inline
+const std::vector<char>& get_packed_transaction(const multisig::packed_trxs& trxtable, const multisig::proposal& prop) {
+   if ( !prop.trx_hash.has_value() ) {
+      return prop.packed_transaction;
+   }
+   return trxtable.get_index<"byhash"_n>().get( prop.trx_hash.value(), "packed transaction not found" ).packed_transaction;
+}
+
+// The blob is billed to the proposer of the latest proposal referencing it, who authorized growing it
+void release_packed_transaction(name self, name proposer, const multisig::proposal& prop) {
+   if ( !prop.trx_hash.has_value() ) {
+      return;
+   }
+   multisig::packed_trxs trxtable( self, self.value );
+   auto idx = trxtable.get_index<"byhash"_n>();
+   auto it = idx.find( prop.trx_hash.value() );
+   if ( it == idx.end() ) {
+      return;
+   }
+   auto ref_it = std::find_if( it->refs.begin(), it->refs.end(), [&](const multisig::proposal_ref& r) {
+         return r.proposer == proposer && r.proposal_name == prop.proposal_name;
+      });
+   if ( ref_it == it->refs.end() ) {
+      return;
+   }
+   if ( it->refs.size() == 1 ) {
+      idx.erase( it );
+   } else {
+      const size_t pos = ref_it - it->refs.begin();
+      const name payer = pos + 1 == it->refs.size() ? it->refs[pos - 1].proposer : it->refs.back().proposer;
+      idx.modify( it, payer, [&]( auto& t ) {
+            t.refs.erase( t.refs.begin() + pos );
+         });
+   }
+}
+
+// Proposals made before the header was stored in the proposals table decode it again
+transaction_header get_trx_header(const multisig::proposal& prop) {
+   if ( prop.trx_header.has_value() ) {
+      return prop.trx_header.value();
+   }
+   return get_trx_header(prop.packed_transaction.data(), prop.packed_transaction.size());
+}
+
 void multisig::propose( name proposer,
                         name proposal_name,
                         std::vector<permission_level> requested,
@@ -71,14 +207,39 @@ void multisig::propose( name proposer,
 
    check( res > 0, "transaction authorization failed" );
 
-   std::vector<char> pkd_trans;
-   pkd_trans.resize(size);
-   memcpy((char*)pkd_trans.data(), trx_pos, size);
+   const checksum256 trx_hash = sha256( trx_pos, size );
+   packed_trxs trxtable( get_self(), get_self().value );
+   auto trx_idx = trxtable.get_index<"byhash"_n>();
+   auto trx_it = trx_idx.find( trx_hash );
+   if ( trx_it == trx_idx.end() ) {
+      trxtable.emplace( proposer, [&]( auto& t ) {
+            t.id       = trxtable.available_primary_key();
+            t.trx_hash = trx_hash;
+            t.packed_transaction.resize( size );
+            memcpy( t.packed_transaction.data(), trx_pos, size );
+            t.refs.push_back( proposal_ref{ proposer, proposal_name } );
+         });
+   } else {
+      trx_idx.modify( trx_it, proposer, [&]( auto& t ) {
+            t.refs.push_back( proposal_ref{ proposer, proposal_name } );
+         });
+   }
+
+   proposal_expirations exptable( get_self(), get_self().value );
+   const uint64_t expiration_id = exptable.available_primary_key();
+   exptable.emplace( proposer, [&]( auto& e ) {
+         e.id            = expiration_id;
+         e.proposer      = proposer;
+         e.proposal_name = proposal_name;
+         e.expiration    = trx_header.expiration;
+      });
 
    proptable.emplace( proposer, [&]( auto& prop ) {
          prop.proposal_name      = proposal_name;
-         prop.packed_transaction = pkd_trans;
          prop.earliest_exec_time.emplace();
+         prop.trx_header.emplace( trx_header );
+         prop.expiration_id.emplace( expiration_id );
+         prop.trx_hash.emplace( trx_hash );
       });
 
    approvals apptable( get_self(), proposer.value );
@@ -89,6 +250,10 @@ void multisig::propose( name proposer,
             a.requested_approvals.push_back( approval{ level, time_point{ microseconds{0} } } );
          }
       });
+
+   for ( const auto& level : requested ) {
+      add_pending_approval( get_self(), proposer, proposal_name, level );
+   }
 }
 
 void multisig::approve( name proposer, name proposal_name, permission_level level,
@@ -100,7 +265,11 @@ void multisig::approve( name proposer, name proposal_name, permission_level leve
    auto& prop = proptable.get( proposal_name.value, "proposal not found" );
 
    if( proposal_hash ) {
-      assert_sha256( prop.packed_transaction.data(), prop.packed_transaction.size(), *proposal_hash );
+      if( prop.trx_hash.has_value() ) {
+         check( *proposal_hash == prop.trx_hash.value(), "hash mismatch" );
+      } else {
+         assert_sha256( prop.packed_transaction.data(), prop.packed_transaction.size(), *proposal_hash );
+      }
    }
 
    approvals apptable( get_self(), proposer.value );
@@ -113,14 +282,16 @@ void multisig::approve( name proposer, name proposal_name, permission_level leve
             a.provided_approvals.push_back( approval{ level, current_time_point() } );
             a.requested_approvals.erase( itr );
          });
+      remove_pending_approval( get_self(), proposer, proposal_name, level );
    }
 
-   transaction_header trx_header = get_trx_header(prop.packed_transaction.data(), prop.packed_transaction.size());
+   transaction_header trx_header = get_trx_header(prop);
 
    if( prop.earliest_exec_time.has_value() ) {
+      // an approval can only make an unauthorized proposal authorized, the valid epoch spares the invalidations lookups
       if( !prop.earliest_exec_time->has_value() ) {
-         auto table_op = [](auto&&, auto&&){};
-         if( trx_is_authorized(get_approvals_and_adjust_table(get_self(), proposer, proposal_name, table_op), prop.packed_transaction) ) {
+         packed_trxs trxtable( get_self(), get_self().value );
+         if( trx_is_authorized(get_approvals_and_adjust_table(get_self(), proposer, proposal_name, record_valid_epoch(proposer)), get_packed_transaction(trxtable, prop)) ) {
             proptable.modify( prop, proposer, [&]( auto& p ) {
                p.earliest_exec_time.emplace(time_point{ current_time_point() + eosio::seconds(trx_header.delay_sec.value)});
             });
@@ -143,6 +314,7 @@ void multisig::unapprove( name proposer, name proposal_name, permission_level le
             a.requested_approvals.push_back( approval{ level, current_time_point() } );
             a.provided_approvals.erase( itr );
          });
+      add_pending_approval( get_self(), proposer, proposal_name, level );
    } else {
       check( false, "proposal not found" );
    }
@@ -150,17 +322,19 @@ void multisig::unapprove( name proposer, name proposal_name, permission_level le
    proposals proptable( get_self(), proposer.value );
    auto& prop = proptable.get( proposal_name.value, "proposal not found" );
 
+   transaction_header trx_header = get_trx_header(prop);
+
    if( prop.earliest_exec_time.has_value() ) {
+      // an unapproval can only make an authorized proposal unauthorized
       if( prop.earliest_exec_time->has_value() ) {
-         auto table_op = [](auto&&, auto&&){};
-         if( !trx_is_authorized(get_approvals_and_adjust_table(get_self(), proposer, proposal_name, table_op), prop.packed_transaction) ) {
+         packed_trxs trxtable( get_self(), get_self().value );
+         if( !trx_is_authorized(get_approvals_and_adjust_table(get_self(), proposer, proposal_name, record_valid_epoch(proposer)), get_packed_transaction(trxtable, prop)) ) {
             proptable.modify( prop, proposer, [&]( auto& p ) {
                p.earliest_exec_time.emplace();
             });
          }
       }
    } else {
-      transaction_header trx_header = get_trx_header(prop.packed_transaction.data(), prop.packed_transaction.size());
       check( trx_header.delay_sec.value == 0, "old proposals are not allowed to have non-zero `delay_sec`; cancel and retry" );
    }
 }
@@ -172,16 +346,14 @@ void multisig::cancel( name proposer, name proposal_name, name canceler ) {
    auto& prop = proptable.get( proposal_name.value, "proposal not found" );
 
    if( canceler != proposer ) {
-      check( unpack<transaction_header>( prop.packed_transaction ).expiration < eosio::time_point_sec(current_time_point()), "cannot cancel until expiration" );
+      check( get_trx_header(prop).expiration < eosio::time_point_sec(current_time_point()), "cannot cancel until expiration" );
    }
+   erase_expiration( get_self(), prop );
+   release_packed_transaction( get_self(), proposer, prop );
    proptable.erase(prop);
 
    //remove from new table
-   approvals apptable( get_self(), proposer.value );
-   auto apps_it = apptable.find( proposal_name.value );
-   if ( apps_it != apptable.end() ) {
-      apptable.erase(apps_it);
-   }
+   erase_approvals( get_self(), proposer, proposal_name );
 }
 
 void multisig::exec( name proposer, name proposal_name, name executer ) {
@@ -192,15 +364,22 @@ void multisig::exec( name proposer, name proposal_name, name executer ) {
    transaction_header trx_header;
    std::vector<action> context_free_actions;
    std::vector<action> actions;
-   datastream<const char*> ds( prop.packed_transaction.data(), prop.packed_transaction.size() );
+   packed_trxs trxtable( get_self(), get_self().value );
+   const auto& packed_trx = get_packed_transaction( trxtable, prop );
+   datastream<const char*> ds( packed_trx.data(), packed_trx.size() );
    ds >> trx_header;
    check( trx_header.expiration >= eosio::time_point_sec(current_time_point()), "transaction expired" );
    ds >> context_free_actions;
    check( context_free_actions.empty(), "not allowed to `exec` a transaction with context-free actions" );
    ds >> actions;
 
-   auto table_op = [](auto&& table, auto&& table_iter) { table.erase(table_iter); };
-   bool ok = trx_is_authorized(get_approvals_and_adjust_table(get_self(), proposer, proposal_name, table_op), prop.packed_transaction);
+   auto table_op = [&](auto&& table, auto&& table_iter, auto&&) {
+      for ( const auto& a : table_iter->requested_approvals ) {
+         remove_pending_approval( get_self(), proposer, proposal_name, a.level );
+      }
+      table.erase(table_iter);
+   };
+   bool ok = trx_is_authorized(get_approvals_and_adjust_table(get_self(), proposer, proposal_name, table_op), packed_trx);
    check( ok, "transaction authorization failed" );
 
    if ( prop.earliest_exec_time.has_value() && prop.earliest_exec_time->has_value() ) {
@@ -213,6 +392,8 @@ void multisig::exec( name proposer, name proposal_name, name executer ) {
       act.send();
    }
 
+   erase_expiration( get_self(), prop );
+   release_packed_transaction( get_self(), proposer, prop );
    proptable.erase(prop);
 }
 
@@ -230,6 +411,55 @@ void multisig::invalidate( name account ) {
             i.last_invalidation_time = current_time_point();
          });
    }
+
+   invalidation_epochs epoch_table( get_self(), get_self().value );
+   auto epoch_it = epoch_table.find( 0 );
+   if ( epoch_it == epoch_table.end() ) {
+      epoch_table.emplace( get_self(), [&](auto& e) {
+            e.epoch = 1;
+         });
+   } else {
+      epoch_table.modify( epoch_it, same_payer, [&](auto& e) {
+            ++e.epoch;
+         });
+   }
+}
+
+time_point_sec multisig::sweep( uint32_t max_count ) {
+   const time_point_sec now = eosio::time_point_sec(current_time_point());
+   max_count = std::min( max_count, max_sweep_count );
+   proposal_expirations exptable( get_self(), get_self().value );
+   auto idx = exptable.get_index<"byexpiration"_n>();
+   auto it = idx.begin();
+   for ( uint32_t count = 0; count < max_count && it != idx.end() && it->expiration < now; ++count ) {
+      proposals proptable( get_self(), it->proposer.value );
+      auto prop_it = proptable.find( it->proposal_name.value );
+      if ( prop_it != proptable.end() && prop_it->expiration_id.has_value() && prop_it->expiration_id.value() == it->id ) {
+         release_packed_transaction( get_self(), it->proposer, *prop_it );
+         proptable.erase( prop_it );
+         erase_approvals( get_self(), it->proposer, it->proposal_name );
+      }
+      it = idx.erase( it );
+   }
+   return it == idx.end() ? time_point_sec() : it->expiration;
+}
+
+std::vector<multisig::pending_proposal> multisig::getpending( permission_level level, uint64_t lower_bound, uint32_t limit ) {
+   std::vector<pending_proposal> result;
+   pending_approvals pending_table( get_self(), level.actor.value );
+   for ( auto it = pending_table.lower_bound( lower_bound ); it != pending_table.end() && result.size() < limit; ++it ) {
+      if ( std::find( it->permissions.begin(), it->permissions.end(), level.permission ) != it->permissions.end() ) {
+         result.push_back( pending_proposal{ it->id, it->proposer, it->proposal_name } );
+      }
+   }
+   return result;
+}
+
+std::vector<char> multisig::getproposal( name proposer, name proposal_name ) {
+   proposals proptable( get_self(), proposer.value );
+   const auto& prop = proptable.get( proposal_name.value, "proposal not found" );
+   packed_trxs trxtable( get_self(), get_self().value );
+   return get_packed_transaction( trxtable, prop );
 }
 
 transaction_header get_trx_header(const char* ptr, size_t sz) {
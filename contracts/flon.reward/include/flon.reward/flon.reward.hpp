@@ -1,11 +1,15 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
 #include <eosio/singleton.hpp>
 #include <eosio/privileged.hpp>
 
+#include <limits>
 #include <string>
+#include <vector>
 
 #define PP(prop) "," #prop ":", prop
 #define PP0(prop) #prop ":", prop
@@ -25,12 +29,41 @@ namespace flon {
    using eosio::asset;
    using eosio::symbol;
    using eosio::block_timestamp;
+   using eosio::checksum256;
 
    static constexpr name      SYSTEM_CONTRACT   = "flon"_n;
    static constexpr name      CORE_TOKEN        = "flon.token"_n;
    // static constexpr symbol    vote_symbol       = symbol("VOTE", 4);
    // static const asset         vote_asset_0      = asset(0, vote_symbol);
    static constexpr int128_t  HIGH_PRECISION    = 1'000'000'000'000'000'000; // 10^18
+   static constexpr int64_t   MIN_BASKET_VOTES  = 10'0000; // votes needed to open a new basket, which the contract pays for
+
+   /**
+    * LEB128 encoding of non-negative int128 accumulators.
+    * A rewards per vote accumulator rarely needs more than half of its 16 bytes.
+    */
+   inline void append_varint128(std::vector<char>& out, const int128_t& value) {
+      CHECK(value >= 0, "varint128 value can not be negative")
+      uint128_t v = value;
+      do {
+         uint8_t b = v & 0x7f;
+         v >>= 7;
+         if (v != 0) b |= 0x80;
+         out.push_back(static_cast<char>(b));
+      } while (v != 0);
+   }
+
+   inline int128_t read_varint128(const std::vector<char>& in, size_t& pos) {
+      uint128_t v = 0;
+      for (uint32_t shift = 0; ; shift += 7) {
+         CHECK(pos < in.size() && shift < 128, "invalid varint128 data")
+         uint8_t b = static_cast<uint8_t>(in[pos++]);
+         v |= uint128_t(b & 0x7f) << shift;
+         if ((b & 0x80) == 0) break;
+      }
+      CHECK((v >> 127) == 0, "invalid varint128 data")
+      return static_cast<int128_t>(v);
+   }
 
    /**
     * The `flon.reward` contract is used as a reward dispatcher contract for flon.system contract.
@@ -42,7 +75,8 @@ namespace flon {
                contract(s, code, ds),
                _global(get_self(), get_self().value),
                _voter_tbl(get_self(), get_self().value),
-               _producer_tbl(get_self(), get_self().value)
+               _producer_tbl(get_self(), get_self().value),
+               _basket_tbl(get_self(), get_self().value)
          {
             _gstate  = _global.exists() ? _global.get() : global_state{};
          }
@@ -70,32 +104,31 @@ namespace flon {
          void regproducer( const name& producer );
 
          /**
-          * addvote.
+          * Notify by addvote() of flon.system contract
           *
-          * @param voter      - the account of voter,
-          * @param votes      - votes value,
+          * @param voter - the account of voter,
+          * @param vote_staked - the added vote staked, its amount is the added votes.
           */
-         [[eosio::action]]
-         void addvote( const name& voter, const int64_t votes );
+         [[eosio::on_notify("flon::addvote")]]
+         void onaddvote( const name& voter, const asset& vote_staked );
 
          /**
-          * subvote.
+          * Notify by subvote() of flon.system contract
           *
-          * @param voter      - the account of voter,
-          * @param votes      - votes value,
+          * @param voter - the account of voter,
+          * @param vote_staked - the subtracted vote staked, its amount is the subtracted votes.
           */
-         [[eosio::action]]
-         void subvote( const name& voter, const int64_t votes );
-
+         [[eosio::on_notify("flon::subvote")]]
+         void onsubvote( const name& voter, const asset& vote_staked );
 
          /**
-          * Vote producer action, votes for a set of producers.
+          * Notify by voteproducer() of flon.system contract
           *
           * @param voter - the account to change the voted producers for,
-          * @param producers - the list of producers to vote for, a maximum of 30 producers is allowed.
+          * @param producers - the unique and sorted list of producers voted for, validated by flon.system.
           */
-         [[eosio::action]]
-         void voteproducer( const name& voter, const std::vector<name>& producers );
+         [[eosio::on_notify("flon::voteproducer")]]
+         void onvoteprod( const name& voter, const std::vector<name>& producers );
 
          /**
           * claim rewards for voter
@@ -112,6 +145,18 @@ namespace flon {
           * @param voter - the account of voter
           */
          ACTION claimfor(const name& clamer, const name& voter );
+
+         /**
+          * Migrate voters action, moves the rewards accounting of legacy voters onto vote baskets.
+          * Legacy voters are also migrated when they are next touched by a vote change or claim.
+          * A voter with less than `MIN_BASKET_VOTES` votes only joins an existing basket, it stays a legacy
+          * voter, with its rewards settled, while no basket exists for its producers.
+          *
+          * @param voters - the accounts of voters to migrate, voters already migrated are skipped.
+          */
+         [[eosio::action]]
+         void migratevoter( const std::vector<name>& voters );
+
         /**
          * Notify by transfer() of xtoken contract
          *
@@ -126,13 +171,27 @@ namespace flon {
                            const asset &quantity,
                            const string &memo);
 
+        struct transfer_item {
+            name     to;
+            asset    quantity;
+            string   memo;
+        };
+
+        /**
+         * Notify by transfers() of xtoken contract, each transfer to this contract is handled as by ontransfer()
+         *
+         * @param from - the account to transfer from,
+         * @param transfers - the recipients, each with the quantity of tokens and the memo of its transfer.
+         */
+        [[eosio::on_notify("flon.token::transfers")]]
+        void ontransfers(  const name &from,
+                           const std::vector<transfer_item> &transfers);
+
          using init_action = eosio::action_wrapper<"init"_n, &flon_reward::init>;
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &flon_reward::regproducer>;
-         using addvote_action = eosio::action_wrapper<"addvote"_n, &flon_reward::addvote>;
-         using subvote_action = eosio::action_wrapper<"subvote"_n, &flon_reward::subvote>;
-         using voteproducer_action = eosio::action_wrapper<"voteproducer"_n, &flon_reward::voteproducer>;
          using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &flon_reward::claimrewards>;
          using claimfor_action = eosio::action_wrapper<"claimfor"_n, &flon_reward::claimfor>;
+         using migratevoter_action = eosio::action_wrapper<"migratevoter"_n, &flon_reward::migratevoter>;
    public:
          struct [[eosio::table("global")]] global_state {
             asset                total_rewards;
@@ -143,6 +202,9 @@ namespace flon {
          /**
           * producer table.
           * scope: contract self
+          * `allocating_rewards` and `allocated_rewards` only account the rewards allocated to legacy voters,
+          * rewards allocated to vote baskets are accounted in the basket.
+          * `votes` is no longer maintained, the votes of a producer are read from the flon.system producers table.
          */
          struct [[eosio::table]] producer {
             name              owner;                                 // PK
@@ -163,11 +225,42 @@ namespace flon {
             int128_t           last_rewards_per_vote         = 0;
          };
 
-         using voted_producer_map = std::map<name, voted_producer_info>;
+         // Sorted by producer name. It has the same binary layout as std::map<name, voted_producer_info>,
+         // without allocating a tree node per entry when the row is decoded.
+         using voted_producer_map = std::vector<std::pair<name, voted_producer_info>>;
+
+         /**
+          * Leading fields of the producers table of flon.system, only read to get the votes of a producer.
+          * scope: flon.system
+         */
+         struct system_producer_info {
+            name              owner;
+            int64_t           total_votes          = 0;
+
+            uint64_t primary_key()const { return owner.value; }
+
+            typedef eosio::multi_index< "producers"_n, system_producer_info > table;
+         };
+
+         /**
+          * Leading fields of the voters table of flon.system, only read to get the producers of a voter.
+          * scope: flon.system
+         */
+         struct system_voter_info {
+            name                 owner;
+            std::vector<name>    producers;
+
+            uint64_t primary_key()const { return owner.value; }
+
+            typedef eosio::multi_index< "voters"_n, system_voter_info > table;
+         };
 
          /**
           * voter table.
           * scope: contract self
+          * `producers` is only used by legacy voters, a voter that has joined a vote basket keeps it empty.
+          * Rows are written from flon.system notifications, so the contract pays for them. A row only exists
+          * while the voter holds votes, at least `min_voter_votes` of flon.system, or has unclaimed rewards.
          */
          struct [[eosio::table]] voter {
             name                       owner;
@@ -176,12 +269,67 @@ namespace flon {
             asset                      unclaimed_rewards;
             asset                      claimed_rewards;
             block_timestamp            update_at;
+            eosio::binary_extension<uint64_t>   basket_id;              // 0 if not voting for any producer
+            eosio::binary_extension<int128_t>   last_rewards_per_vote;  // rewards_per_vote of basket at last settlement
 
             uint64_t primary_key()const { return owner.value; }
 
+            uint64_t get_basket_id()const { return basket_id.has_value() ? basket_id.value() : 0; }
+            bool is_legacy()const { return !basket_id.has_value() && !producers.empty(); }
+
             typedef eosio::multi_index< "voters"_n, voter > table;
          };
 
+         static inline checksum256 hash_producers(const std::vector<name>& producers) {
+            auto data = eosio::pack(producers);
+            return eosio::sha256(data.data(), data.size());
+         }
+
+         /**
+          * vote basket table.
+          * All voters voting for the same producer set share one basket, they hold its shares by their votes.
+          * The basket accumulates the rewards per vote of all of its producers, so that settling a voter
+          * only touches the basket instead of every voted producer.
+          * Opening a new basket needs at least `MIN_BASKET_VOTES` votes, joining an existing one does not:
+          * a smaller voter is accounted per producer, as a legacy voter, until a basket of its producers exists.
+          * scope: contract self
+         */
+         struct [[eosio::table]] basket {
+            uint64_t                   id;                              // PK
+            std::vector<name>          producers;                       // sorted voted producers
+            std::vector<char>          last_rewards_per_vote;           // rewards_per_vote of producers at last sync, varint128 encoded
+            int64_t                    votes                = 0;        // total votes of voters in basket
+            uint32_t                   voter_count          = 0;
+            int128_t                   rewards_per_vote     = 0;        // accumulated rewards per vote of all producers
+            asset                      allocated_rewards;               // rewards allocated from producers
+            block_timestamp            update_at;
+
+            uint64_t primary_key()const { return id; }
+            checksum256 by_producers()const { return hash_producers(producers); }
+
+            std::vector<int128_t> get_last_rewards_per_vote()const {
+               std::vector<int128_t> values;
+               values.reserve(producers.size());
+               size_t pos = 0;
+               while (pos < last_rewards_per_vote.size()) {
+                  values.push_back(read_varint128(last_rewards_per_vote, pos));
+               }
+               CHECK(values.size() == producers.size(), "basket last_rewards_per_vote mismatch")
+               return values;
+            }
+
+            void set_last_rewards_per_vote(const std::vector<int128_t>& values) {
+               last_rewards_per_vote.clear();
+               for (const auto& v : values) {
+                  append_varint128(last_rewards_per_vote, v);
+               }
+            }
+
+            typedef eosio::multi_index< "baskets"_n, basket,
+               eosio::indexed_by<"byproducers"_n, eosio::const_mem_fun<basket, checksum256, &basket::by_producers>>
+            > table;
+         };
+
 
          static inline bool is_producer_registered(const name& contract_account, const name& producer) {
             producer::table producer_tbl(contract_account, contract_account.value);
@@ -191,18 +339,114 @@ namespace flon {
             }
             return false;
          }
+
+         /**
+          * Returns the unclaimed rewards of voter `v` as claimrewards would settle them now, without modifying any table.
+          * It goes through the same settlement as claimrewards: a legacy voter is settled through its voted producers,
+          * other voters through their basket, synced with the rewards_per_vote of the basket producers.
+          */
+         static asset get_unclaimed_rewards(const name& contract_account, voter v) {
+            if (v.is_legacy()) {
+               for (const auto& voted_prod : v.producers) {
+                  const auto& last_rewards_per_vote = voted_prod.second.last_rewards_per_vote;
+                  const auto rewards_per_vote = get_rewards_per_vote(contract_account, voted_prod.first);
+                  CHECK(rewards_per_vote >= last_rewards_per_vote, "last_rewards_per_vote invalid");
+                  if (rewards_per_vote > last_rewards_per_vote && v.votes > 0) {
+                     v.unclaimed_rewards += calc_voter_rewards(v.votes, rewards_per_vote - last_rewards_per_vote, v.unclaimed_rewards.symbol);
+                  }
+               }
+               // migrating joins the basket at its current rewards_per_vote, nothing more is due from it
+               return v.unclaimed_rewards;
+            }
+
+            const auto basket_id = v.get_basket_id();
+            if (basket_id != 0) {
+               basket::table basket_tbl(contract_account, contract_account.value);
+               auto b = basket_tbl.get(basket_id, "basket not found");
+               sync_basket(contract_account, b);
+               settle_voter(v, b);
+            }
+            return v.unclaimed_rewards;
+         }
    private:
       global_state::table     _global;
       global_state            _gstate;
       voter::table            _voter_tbl;
       producer::table         _producer_tbl;
+      basket::table           _basket_tbl;
 
       void claim_rewards( const name& voter );
-      void allocate_producer_rewards(voted_producer_map& producers, int64_t votes_old, int64_t votes_delta, const name& new_payer, asset &allocated_rewards_out);
+      void allocate_producer_rewards(voted_producer_map& producers, int64_t votes, asset &allocated_rewards_out);
+      void migrate_voter(voter& v);
+      void join_basket(voter& v, const std::vector<name>& producers);
+      void leave_basket(voter& v);
       void change_vote(const name& voter, int64_t votes, bool is_adding);
       void check_init() const;
+      void add_producer_rewards(const name& producer, const asset& quantity);
       const symbol& core_symbol() const;
-      asset calc_voter_rewards(int64_t votes, const int128_t& rewards_per_vote) const;
+
+      // The settlement arithmetic, shared by the actions and get_unclaimed_rewards
+
+      static asset calc_voter_rewards(int64_t votes, const int128_t& rewards_per_vote, const symbol& sym) {
+         ASSERT(votes >= 0 && rewards_per_vote >= 0);
+         CHECK(votes * rewards_per_vote >= rewards_per_vote, "calculated rewards overflow");
+         int128_t rewards = votes * rewards_per_vote / HIGH_PRECISION;
+         CHECK(rewards >= 0 && rewards <= std::numeric_limits<int64_t>::max(), "calculated rewards overflow");
+         return asset((int64_t)rewards, sym);
+      }
+
+      // Returns the accumulated rewards per vote of a producer, 0 if it has never registered for rewards
+      static int128_t get_rewards_per_vote(const name& contract_account, const name& producer) {
+         producer::table producer_tbl(contract_account, contract_account.value);
+         auto prod_itr = producer_tbl.find(producer.value);
+         return prod_itr != producer_tbl.end() ? prod_itr->rewards_per_vote : 0;
+      }
+
+      // Accumulates the rewards per vote that the basket producers have received since the last sync.
+      // Producer rows are only read. Returns false if none of them has received rewards, `b` is unchanged then.
+      static bool sync_basket(const name& contract_account, basket& b) {
+         auto last_rewards_per_votes = b.get_last_rewards_per_vote();
+
+         asset new_rewards(0, b.allocated_rewards.symbol);
+         bool changed = false;
+         for (size_t i = 0; i < b.producers.size(); ++i) {
+            const auto rewards_per_vote = get_rewards_per_vote(contract_account, b.producers[i]);
+            auto& last_rewards_per_vote = last_rewards_per_votes[i];
+
+            CHECK(rewards_per_vote >= last_rewards_per_vote, "last_rewards_per_vote invalid");
+            int128_t rewards_per_vote_delta = rewards_per_vote - last_rewards_per_vote;
+            if (rewards_per_vote_delta > 0) {
+               if (b.votes > 0) {
+                  new_rewards += calc_voter_rewards(b.votes, rewards_per_vote_delta, new_rewards.symbol);
+               }
+               const auto old_rewards_per_vote = b.rewards_per_vote;
+               b.rewards_per_vote += rewards_per_vote_delta;
+               CHECK(b.rewards_per_vote >= old_rewards_per_vote, "basket rewards_per_vote overflow")
+               last_rewards_per_vote = rewards_per_vote;
+               changed = true;
+            }
+         }
+
+         if (!changed) {
+            return false;
+         }
+
+         b.set_last_rewards_per_vote(last_rewards_per_votes);
+         b.allocated_rewards += new_rewards;
+         b.update_at = eosio::current_time_point();
+         return true;
+      }
+
+      // Moves the rewards of the voter's basket shares since its last settlement to its unclaimed rewards.
+      static void settle_voter(voter& v, const basket& b) {
+         auto& last_rewards_per_vote = v.last_rewards_per_vote.value();
+         CHECK(b.rewards_per_vote >= last_rewards_per_vote, "voter last_rewards_per_vote invalid");
+         int128_t rewards_per_vote_delta = b.rewards_per_vote - last_rewards_per_vote;
+         if (rewards_per_vote_delta > 0 && v.votes > 0) {
+            v.unclaimed_rewards += calc_voter_rewards(v.votes, rewards_per_vote_delta, v.unclaimed_rewards.symbol);
+         }
+         last_rewards_per_vote = b.rewards_per_vote;
+      }
    };
 
 }
@@ -1,5 +1,7 @@
 #include <flon.reward/flon.reward.hpp>
 #include <eosio/system.hpp>
+
+#include <algorithm>
 #ifdef ENABLE_CONTRACT_VERSION
 #include <contract_version.hpp>
 #endif//ENABLE_CONTRACT_VERSION
@@ -64,14 +66,6 @@ inline static int128_t calc_rewards_per_vote(const int128_t& old_rewards_per_vot
    return new_rewards_per_vote;
 }
 
- asset flon_reward::calc_voter_rewards(int64_t votes, const int128_t& rewards_per_vote) const {
-   ASSERT(votes >= 0 && rewards_per_vote >= 0);
-   CHECK(votes * rewards_per_vote >= rewards_per_vote, "calculated rewards overflow");
-   int128_t rewards = votes * rewards_per_vote / HIGH_PRECISION;
-   CHECK(rewards >= 0 && rewards <= std::numeric_limits<int64_t>::max(), "calculated rewards overflow");
-   return asset((int64_t)rewards, core_symbol());
-}
-
 void flon_reward::init( const symbol& core_symbol ) {
    require_auth(SYSTEM_CONTRACT);
    CHECK(!_gstate.total_rewards.symbol.is_valid(), "reward contract has already been initialized")
@@ -101,75 +95,42 @@ void flon_reward::regproducer( const name& producer ) {
    });
 }
 
-void flon_reward::addvote( const name& voter, int64_t votes ) {
+void flon_reward::onaddvote( const name& voter, const asset& vote_staked ) {
    check_init();
-   change_vote(voter, votes, true /* is_adding */);
+   change_vote(voter, vote_staked.amount, true /* is_adding */);
 }
 
-
-void flon_reward::subvote( const name& voter, const int64_t votes ) {
+void flon_reward::onsubvote( const name& voter, const asset& vote_staked ) {
    check_init();
-   change_vote(voter, votes, false /* is_adding */);
+   change_vote(voter, vote_staked.amount, false /* is_adding */);
 }
 
-void flon_reward::voteproducer( const name& voter, const std::vector<name>& producers ) {
+void flon_reward::onvoteprod( const name& voter, const std::vector<name>& producers ) {
    check_init();
 
-   require_auth( SYSTEM_CONTRACT );
-   require_auth( voter );
-
-   for( size_t i = 1; i < producers.size(); ++i ) {
-      check( producers[i - 1] < producers[i], "producer votes must be uniqued and sorted" );
+   auto voter_itr = _voter_tbl.find(voter.value);
+   if (voter_itr == _voter_tbl.end() || voter_itr->votes == 0) {
+      // a voter without votes holds no basket shares, its next addvote joins the basket of its producers
+      return;
    }
 
    auto now = eosio::current_time_point();
-
-   auto voter_itr = _voter_tbl.find(voter.value);
-   db::set(_voter_tbl, voter_itr, voter, voter, [&]( auto& v, bool is_new ) {
-      if (is_new) {
-         v.owner = voter;
-         v.unclaimed_rewards = asset(0, core_symbol());
-         v.claimed_rewards = asset(0, core_symbol());
+   _voter_tbl.modify(voter_itr, same_payer, [&]( auto& v ) {
+      migrate_voter(v);
+      if (v.is_legacy()) {
+         // settled by migrate_voter, the voter leaves its legacy producers
+         v.producers.clear();
+         v.basket_id.emplace(0);
+         v.last_rewards_per_vote.emplace(0);
       }
 
-      voted_producer_map added_prods;
-      voted_producer_map removed_prods;
-
-      auto new_prod_itr = producers.begin();
-      auto old_prod_itr = v.producers.begin();
-      while( old_prod_itr != v.producers.end() || new_prod_itr != producers.end() ) {
-
-         if (old_prod_itr != v.producers.end() && new_prod_itr != producers.end()) {
-            if ( old_prod_itr->first < (*new_prod_itr) ) {
-               // old is discarded and add to removed_prods, new is processed in next loop
-               removed_prods.emplace(*old_prod_itr);
-               old_prod_itr = v.producers.erase(old_prod_itr);
-            }else if ( (*new_prod_itr) < old_prod_itr->first ) {
-               // old is processed in next loop, new is added to added_prods
-               added_prods[*new_prod_itr] = {};
-               new_prod_itr++;
-            } else { // old_prod_itr->first == (*new_prod_itr))
-               // old is keeped in v.producers, new is discarded
-               old_prod_itr++;
-               new_prod_itr++;
-            }
-         } else if (old_prod_itr != v.producers.end()) {
-            // no new, old is discarded and add to removed_prods,
-            removed_prods.emplace(*old_prod_itr);
-            old_prod_itr = v.producers.erase(old_prod_itr);
-         } else { // new_prod_itr != producers.end()
-            // no old, new is added to added_prods
-            added_prods[*new_prod_itr] = {};
-            new_prod_itr++;
-         }
+      const auto basket_id = v.get_basket_id();
+      if (basket_id != 0 ? _basket_tbl.get(basket_id, "basket not found").producers == producers : producers.empty()) {
+         return;
       }
 
-      allocate_producer_rewards(removed_prods, v.votes, -v.votes, voter, v.unclaimed_rewards);
-      allocate_producer_rewards(v.producers, v.votes, 0, voter, v.unclaimed_rewards);
-      allocate_producer_rewards(added_prods, 0, v.votes, voter, v.unclaimed_rewards);
-      for (auto& added_prod : added_prods) {
-         v.producers.emplace(added_prod);
-      }
+      leave_basket(v);
+      join_basket(v, producers);
 
       v.update_at    = now;
    });
@@ -185,17 +146,36 @@ void flon_reward::claim_rewards( const name& voter ) {
    auto voter_itr = _voter_tbl.find(voter.value);
    check(voter_itr != _voter_tbl.end(), "voter info not found");
 
-   _voter_tbl.modify(voter_itr, voter, [&]( auto& v) {
-      if (voter_itr->votes > 0) {
-         allocate_producer_rewards(v.producers, v.votes, 0, voter, v.unclaimed_rewards);
+   auto v = *voter_itr;
+   migrate_voter(v);
+
+   const auto basket_id = v.get_basket_id();
+   if (basket_id != 0) {
+      auto basket_itr = _basket_tbl.find(basket_id);
+      check(basket_itr != _basket_tbl.end(), "basket not found");
+      auto b = *basket_itr;
+      if (sync_basket(get_self(), b)) {
+         _basket_tbl.modify(basket_itr, same_payer, [&]( auto& r ) {
+            r = b;
+         });
       }
-      check(v.unclaimed_rewards.amount > 0, "no rewards to claim");
+      settle_voter(v, b);
+   }
+   check(v.unclaimed_rewards.amount > 0, "no rewards to claim");
 
-      TRANSFER_OUT(CORE_TOKEN, voter, v.unclaimed_rewards, "voted rewards");
+   TRANSFER_OUT(CORE_TOKEN, voter, v.unclaimed_rewards, "voted rewards");
 
-      v.claimed_rewards += v.unclaimed_rewards;
-      v.unclaimed_rewards.amount = 0;
-      v.update_at = current_time_point();
+   if (v.votes == 0) {
+      // the voter has subtracted all of its votes, nothing more is due to it
+      _voter_tbl.erase(voter_itr);
+      return;
+   }
+
+   _voter_tbl.modify(voter_itr, same_payer, [&]( auto& r ) {
+      r = v;
+      r.claimed_rewards += r.unclaimed_rewards;
+      r.unclaimed_rewards.amount = 0;
+      r.update_at = current_time_point();
    });
 }
 
@@ -205,57 +185,134 @@ void flon_reward::claimfor(const name& claimer, const name& voter) {
    claim_rewards(voter);
 }
 
+void flon_reward::migratevoter( const std::vector<name>& voters ) {
+   check_init();
+
+   // Migrating never grows a voter row: the legacy producer entries it drops are at least as large as
+   // the basket fields it adds, and a new basket is only opened for at least MIN_BASKET_VOTES votes.
+   // Hence anyone can push it.
+   auto now = eosio::current_time_point();
+   for (const auto& voter : voters) {
+      auto voter_itr = _voter_tbl.find(voter.value);
+      if (voter_itr == _voter_tbl.end() || !voter_itr->is_legacy()) {
+         continue;
+      }
+      _voter_tbl.modify(voter_itr, same_payer, [&]( auto& v ) {
+         migrate_voter(v);
+         v.update_at = now;
+      });
+   }
+}
+
 void flon_reward::ontransfer(    const name &from,
                                  const name &to,
                                  const asset &quantity,
                                  const string &memo)
 {
    if (get_first_receiver() == CORE_TOKEN && quantity.symbol == core_symbol() && from != get_self() && to == get_self()) {
-      _gstate.total_rewards += quantity;
-      _global.set(_gstate, get_self());
-
-      auto prod_itr = _producer_tbl.find(from.value);
-      check(prod_itr != _producer_tbl.end(), "producer(from) not found");
-      check(prod_itr->is_registered, "producer(from) not registered");
-      _producer_tbl.modify(prod_itr, same_payer, [&]( auto& p ) {
-         p.total_rewards         += quantity;
-         p.allocating_rewards   += quantity;
-         p.rewards_per_vote      = calc_rewards_per_vote(p.rewards_per_vote, quantity, p.votes);
-         p.update_at = eosio::current_time_point();
-      });
+      add_producer_rewards(from, quantity);
    }
 }
 
-void flon_reward::change_vote(const name& voter, int64_t votes, bool is_adding) {
-   require_auth( SYSTEM_CONTRACT );
-   require_auth( voter );
+void flon_reward::ontransfers(   const name &from,
+                                 const std::vector<transfer_item> &transfers)
+{
+   if (get_first_receiver() != CORE_TOKEN || from == get_self())
+      return;
+
+   for (const auto& t : transfers) {
+      if (t.to == get_self() && t.quantity.symbol == core_symbol()) {
+         add_producer_rewards(from, t.quantity);
+      }
+   }
+}
 
+// Rewards paid by a producer to its voters
+void flon_reward::add_producer_rewards(const name& producer, const asset& quantity) {
+   _gstate.total_rewards += quantity;
+   _global.set(_gstate, get_self());
+
+   auto prod_itr = _producer_tbl.find(producer.value);
+   check(prod_itr != _producer_tbl.end(), "producer(from) not found");
+   check(prod_itr->is_registered, "producer(from) not registered");
+
+   system_producer_info::table system_producer_tbl(SYSTEM_CONTRACT, SYSTEM_CONTRACT.value);
+   auto system_prod_itr = system_producer_tbl.find(producer.value);
+   const int64_t votes = system_prod_itr != system_producer_tbl.end() ? system_prod_itr->total_votes : 0;
+
+   _producer_tbl.modify(prod_itr, same_payer, [&]( auto& p ) {
+      p.total_rewards         += quantity;
+      p.allocating_rewards   += quantity;
+      p.rewards_per_vote      = calc_rewards_per_vote(p.rewards_per_vote, quantity, votes);
+      p.update_at = eosio::current_time_point();
+   });
+}
+
+// Adds or subtracts the votes of a voter. A voter gets a row with its first votes and loses it when its
+// votes reach 0 without unclaimed rewards, so the rows paid by the contract are bounded by the voters
+// holding at least `min_voter_votes` in flon.system.
+void flon_reward::change_vote(const name& voter, int64_t votes, bool is_adding) {
    CHECK(votes > 0, "votes must be positive")
 
-   auto now = eosio::current_time_point();
    auto voter_itr = _voter_tbl.find(voter.value);
-   db::set(_voter_tbl, voter_itr, voter, voter, [&]( auto& v, bool is_new ) {
-      if (is_new) {
-         v.owner = voter;
-         v.unclaimed_rewards = asset(0, core_symbol());
-         v.claimed_rewards = asset(0, core_symbol());
-      }
+   voter v;
+   if (voter_itr == _voter_tbl.end()) {
+      v.owner = voter;
+      v.votes = 0;
+      v.unclaimed_rewards = asset(0, core_symbol());
+      v.claimed_rewards = asset(0, core_symbol());
+      v.basket_id.emplace(0);
+      v.last_rewards_per_vote.emplace(0);
+   } else {
+      v = *voter_itr;
+      migrate_voter(v);
+   }
 
-      auto votes_delta = votes;
-      if (!is_adding) {
-         CHECK(v.votes >= votes, "voter's votes insufficent")
-         votes_delta = -votes;
+   CHECK(is_adding || v.votes >= votes, "voter's votes insufficent")
+   const auto votes_delta = is_adding ? votes : -votes;
+
+   if (v.votes == 0) {
+      // the voter holds no basket shares, it joins the basket of the producers it votes for in flon.system
+      system_voter_info::table system_voter_tbl(SYSTEM_CONTRACT, SYSTEM_CONTRACT.value);
+      const auto& system_voter = system_voter_tbl.get(voter.value, "voter not found in system contract");
+      v.producers.clear();
+      v.votes = votes_delta;
+      join_basket(v, system_voter.producers);
+   } else if (v.votes + votes_delta == 0) {
+      leave_basket(v);
+      v.producers.clear();
+      v.votes = 0;
+   } else {
+      const auto basket_id = v.get_basket_id();
+      if (basket_id != 0) {
+         auto basket_itr = _basket_tbl.find(basket_id);
+         CHECK(basket_itr != _basket_tbl.end(), "basket not found")
+         _basket_tbl.modify(basket_itr, same_payer, [&]( auto& b ) {
+            sync_basket(get_self(), b);
+            settle_voter(v, b);
+            b.votes += votes_delta;
+            CHECK(b.votes >= 0, "basket votes can not be negative")
+         });
       }
-      allocate_producer_rewards(v.producers, v.votes, votes_delta, voter, v.unclaimed_rewards);
-      v.votes        += votes_delta;
-      CHECK(v.votes >= 0, "voter's votes can not be negative")
+      v.votes += votes_delta;
+   }
+   v.update_at = eosio::current_time_point();
 
-      v.update_at    = now;
-   });
+   if (v.votes == 0 && v.unclaimed_rewards.amount == 0) {
+      _voter_tbl.erase(voter_itr);
+   } else if (voter_itr == _voter_tbl.end()) {
+      _voter_tbl.emplace(get_self(), [&]( auto& r ) {
+         r = v;
+      });
+   } else {
+      _voter_tbl.modify(voter_itr, same_payer, [&]( auto& r ) {
+         r = v;
+      });
+   }
 }
 
-void flon_reward::allocate_producer_rewards(voted_producer_map& producers, int64_t votes_old,
-         int64_t votes_delta, const name& new_payer, asset &allocated_rewards_out)
+// Allocates the rewards of legacy voted producers to a voter holding `votes`.
+void flon_reward::allocate_producer_rewards(voted_producer_map& producers, int64_t votes, asset &allocated_rewards_out)
 {
 
    auto now = eosio::current_time_point();
@@ -264,37 +321,136 @@ void flon_reward::allocate_producer_rewards(voted_producer_map& producers, int64
       auto& last_rewards_per_vote = voted_prod.second.last_rewards_per_vote; // will be updated below
 
       auto prod_itr = _producer_tbl.find(prod_name.value);
-      db::set(_producer_tbl, prod_itr, new_payer, same_payer, [&]( auto& p, bool is_new ) {
-         if (is_new) {
-            p.owner = prod_name;
-            p.total_rewards = asset(0, core_symbol());
-            p.allocating_rewards = asset(0, core_symbol());
-            p.allocated_rewards = asset(0, core_symbol());
-         }
-
-         CHECK(p.rewards_per_vote >= last_rewards_per_vote, "last_rewards_per_vote invalid");
-         int128_t rewards_per_vote_delta = p.rewards_per_vote - last_rewards_per_vote;
-         if (rewards_per_vote_delta > 0 && votes_old > 0) {
-            ASSERT(votes_old <= p.votes)
-            asset new_rewards = calc_voter_rewards(votes_old, rewards_per_vote_delta);
+      if (prod_itr == _producer_tbl.end()) {
+         // a producer never rewarded has nothing to allocate
+         continue;
+      }
+
+      CHECK(prod_itr->rewards_per_vote >= last_rewards_per_vote, "last_rewards_per_vote invalid");
+      int128_t rewards_per_vote_delta = prod_itr->rewards_per_vote - last_rewards_per_vote;
+      if (rewards_per_vote_delta > 0 && votes > 0) {
+         asset new_rewards = calc_voter_rewards(votes, rewards_per_vote_delta, core_symbol());
+         _producer_tbl.modify(prod_itr, same_payer, [&]( auto& p ) {
             CHECK(p.allocating_rewards >= new_rewards, "producer allocating rewards insufficient");
             p.allocating_rewards -= new_rewards;
             p.allocated_rewards += new_rewards;
 
             ASSERT(p.total_rewards == p.allocating_rewards + p.allocated_rewards)
+            p.update_at = now;
+         });
+
+         allocated_rewards_out += new_rewards; // update allocated_rewards for voter
+      }
+
+      last_rewards_per_vote = prod_itr->rewards_per_vote; // update for voted_prod
+   }
+}
+
+// Settles the rewards of a legacy voter through its voted producers, then moves it into the basket
+// of those producers.
+void flon_reward::migrate_voter(voter& v) {
+   if (!v.is_legacy()) {
+      return;
+   }
+
+   allocate_producer_rewards(v.producers, v.votes, v.unclaimed_rewards);
+
+   std::vector<name> producers;
+   producers.reserve(v.producers.size());
+   for (const auto& voted_prod : v.producers) {
+      producers.push_back(voted_prod.first);
+   }
+   v.producers.clear();
+
+   join_basket(v, producers);
+}
+
+// Adds the voter's votes as shares of the basket of `producers`. A new basket is paid by the contract as
+// it is shared by all of its voters, so opening one needs at least MIN_BASKET_VOTES votes.
+// A smaller voter without a basket to join is kept as a legacy voter of `producers`.
+void flon_reward::join_basket(voter& v, const std::vector<name>& producers) {
+   if (producers.empty()) {
+      v.basket_id.emplace(0);
+      v.last_rewards_per_vote.emplace(0);
+      return;
+   }
 
-            allocated_rewards_out += new_rewards; // update allocated_rewards for voter
-         }
+   auto basket_idx = _basket_tbl.get_index<"byproducers"_n>();
+   auto basket_itr = basket_idx.find(hash_producers(producers));
 
-         p.votes += votes_delta;
-         CHECK(p.votes >= 0, "producer votes can not be negative")
-         p.update_at = now;
+   if (basket_itr == basket_idx.end() && v.votes < MIN_BASKET_VOTES) {
+      // too few votes to open a basket, the rewards of the voter are settled per producer as a legacy voter
+      for (const auto& prod_name : producers) {
+         v.producers.emplace_back(prod_name, voted_producer_info{ get_rewards_per_vote(get_self(), prod_name) });
+      }
+      v.basket_id.reset();
+      v.last_rewards_per_vote.reset();
+      return;
+   }
+
+   basket b;
+   if (basket_itr == basket_idx.end()) {
+      b.id = std::max<uint64_t>(1, _basket_tbl.available_primary_key());
+      b.producers = producers;
+      std::vector<int128_t> last_rewards_per_votes;
+      last_rewards_per_votes.reserve(producers.size());
+      for (const auto& prod_name : producers) {
+         last_rewards_per_votes.push_back(get_rewards_per_vote(get_self(), prod_name));
+      }
+      b.set_last_rewards_per_vote(last_rewards_per_votes);
+      b.allocated_rewards = asset(0, core_symbol());
+      b.update_at = eosio::current_time_point();
+   } else {
+      CHECK(basket_itr->producers == producers, "basket producers mismatch")
+      b = *basket_itr;
+      sync_basket(get_self(), b);
+   }
 
-         last_rewards_per_vote = p.rewards_per_vote; // update for voted_prod
+   b.votes += v.votes;
+   b.voter_count++;
+   v.basket_id.emplace(b.id);
+   v.last_rewards_per_vote.emplace(b.rewards_per_vote);
+
+   if (basket_itr == basket_idx.end()) {
+      _basket_tbl.emplace(get_self(), [&]( auto& r ) {
+         r = b;
+      });
+   } else {
+      basket_idx.modify(basket_itr, same_payer, [&]( auto& r ) {
+         r = b;
       });
    }
 }
 
+// Settles the voter and removes its shares from its basket, the basket is erased with its last voter.
+void flon_reward::leave_basket(voter& v) {
+   const auto basket_id = v.get_basket_id();
+   if (basket_id == 0) {
+      return;
+   }
+
+   auto basket_itr = _basket_tbl.find(basket_id);
+   CHECK(basket_itr != _basket_tbl.end(), "basket not found")
+
+   auto b = *basket_itr;
+   sync_basket(get_self(), b);
+   settle_voter(v, b);
+   b.votes -= v.votes;
+   CHECK(b.votes >= 0 && b.voter_count > 0, "basket votes can not be negative")
+   b.voter_count--;
+
+   if (b.voter_count == 0) {
+      _basket_tbl.erase(basket_itr);
+   } else {
+      _basket_tbl.modify(basket_itr, same_payer, [&]( auto& r ) {
+         r = b;
+      });
+   }
+
+   v.basket_id.emplace(0);
+   v.last_rewards_per_vote.emplace(0);
+}
+
 void flon_reward::check_init() const {
    CHECK( _gstate.total_rewards.symbol.is_valid(), "reward contract has not been initialized" )
 }
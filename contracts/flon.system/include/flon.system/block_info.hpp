@@ -2,6 +2,7 @@
 
 #include <eosio/multi_index.hpp>
 #include <eosio/name.hpp>
+#include <eosio/system.hpp>
 #include <eosio/time.hpp>
 
 #include <limits>
@@ -11,14 +12,22 @@ namespace eosiosystem::block_info {
 
 static constexpr uint32_t rolling_window_size = 10;
 
+/**
+ * Returns the slot of the blockinfo ring buffer holding the record for `block_height`.
+ */
+inline uint64_t block_info_slot(uint32_t block_height) { return block_height % rolling_window_size; }
+
 /**
  * The blockinfo table holds a rolling window of records containing information for recent blocks.
  *
  * Each record stores the height and timestamp of the correspond block.
- * A record is added for a new block through the onblock action.
- * The onblock action also erases up to two old records at a time in an attempt to keep the table consisting of only
- * records for blocks going back a particular block height difference backward from the most recent block.
- * Currently that block height difference is hardcoded to 10.
+ * The table is a ring buffer of a fixed set of rows keyed by `block_height % rolling_window_size`: the onblock action
+ * overwrites in place the slot of the new block, which held the record of the block that just fell out of the rolling
+ * window. Currently the rolling window size is hardcoded to 10.
+ *
+ * Records written before the table became a ring buffer are keyed by block height, hence always have a primary key not
+ * less than the rolling window size. The onblock action erases up to two of them at a time while the ring buffer is
+ * still being filled.
  */
 struct [[eosio::table, eosio::contract("flon.system")]] block_info_record
 {
@@ -26,7 +35,7 @@ struct [[eosio::table, eosio::contract("flon.system")]] block_info_record
    uint32_t          block_height;
    eosio::time_point block_timestamp;
 
-   uint64_t primary_key() const { return block_height; }
+   uint64_t primary_key() const { return block_info_slot(block_height); }
 
    EOSLIB_SERIALIZE(block_info_record, (version)(block_height)(block_timestamp))
 };
@@ -95,15 +104,26 @@ latest_block_batch_info_result get_latest_block_batch_info(uint32_t    batch_sta
    block_info_table t(system_account_name, 0);
 
    // Find information on latest block recorded in the blockinfo table.
+   // Normally it is the record of the current block written by its onblock action. Otherwise walk back through the
+   // ring buffer to the most recent slot whose record matches its expected height.
+
+   auto           latest_block_info_itr = t.cend();
+   const uint32_t current_block_height  = eosio::current_block_number();
+   for (uint32_t i = 0; i < rolling_window_size && i <= current_block_height; ++i) {
+      const uint32_t block_height = current_block_height - i;
+      auto           itr          = t.find(block_info_slot(block_height));
+      if (itr != t.cend() && itr->block_height == block_height) {
+         latest_block_info_itr = itr;
+         break;
+      }
+   }
 
-   if (t.cbegin() == t.cend()) {
-      // The blockinfo table is empty.
+   if (latest_block_info_itr == t.cend()) {
+      // The blockinfo table has no record within the rolling window.
       result.error_code = latest_block_batch_info_result::insufficient_data;
       return result;
    }
 
-   auto latest_block_info_itr = --t.cend();
-
    if (latest_block_info_itr->version != 0) {
       // Compiled code for this function within the calling contract has not been updated to support new version of
       // the blockinfo table.
@@ -141,15 +161,15 @@ latest_block_batch_info_result get_latest_block_batch_info(uint32_t    batch_sta
 
    // Find information on start block of the latest block batch recorded in the blockinfo table.
 
-   auto start_block_info_itr = t.find(latest_block_batch_start_height);
+   auto start_block_info_itr = t.find(block_info_slot(latest_block_batch_start_height));
    if (start_block_info_itr == t.cend() || start_block_info_itr->block_height != latest_block_batch_start_height) {
       // Record for information on start block of the latest block batch could not be found in blockinfo table.
       // This is either because of:
       //    * a gap in recording info due to a failed onblock action;
       //    * a requested start block that was processed by onblock prior to deployment of the system contract code
       //    introducing the blockinfo table;
-      //    * or, most likely, because the record for the requested start block was pruned from the blockinfo table as
-      //    it fell out of the rolling window.
+      //    * or, most likely, because the record for the requested start block was overwritten in the blockinfo table
+      //    as it fell out of the rolling window.
       result.error_code = latest_block_batch_info_result::insufficient_data;
       return result;
    }
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <eosio/check.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/crypto_bls_ext.hpp>
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace eosiosystem {
+
+   /**
+    * Verifies the proofs of possession of a batch of finalizer keys with a single multi-pairing.
+    *
+    * Each proof `pop_i` of key `pk_i` is a signature of the key itself, valid when e(G1, pop_i) == e(pk_i, H(pk_i)).
+    * The proofs are combined with random 128-bit coefficients `r_i` into one check,
+    *
+    *    e(-G1, sum(r_i * pop_i)) * prod(e(r_i * pk_i, H(pk_i))) == 1,
+    *
+    * which costs one G2 weighted sum, one G1 scalar multiplication per key and a single final exponentiation,
+    * instead of a full pairing check per key. The coefficients are derived from a hash of all keys and proofs,
+    * so they are fixed only once every proof is, and an invalid proof passes with probability at most 2^-128.
+    *
+    * @param keys - finalizer keys in affine little endian non-montgomery g1 form
+    * @param proofs - proofs of possession of `keys`, in the same order, in affine little endian non-montgomery g2 form
+    *
+    * @return true if every proof is valid for its key
+    */
+   inline bool bls_pop_verify_batch( const std::vector<eosio::bls_g1>& keys, const std::vector<eosio::bls_g2>& proofs ) {
+      eosio::check( keys.size() == proofs.size(), "number of finalizer keys and proofs of possession mismatch" );
+
+      const uint32_t count = keys.size();
+      if( count == 0 ) {
+         return true;
+      }
+      if( count == 1 ) {
+         return eosio::bls_pop_verify( keys[0], proofs[0] );
+      }
+
+      std::vector<char> transcript;
+      transcript.reserve( count * (sizeof(eosio::bls_g1) + sizeof(eosio::bls_g2)) );
+      for( uint32_t i = 0; i < count; ++i ) {
+         transcript.insert( transcript.end(), keys[i].begin(), keys[i].end() );
+         transcript.insert( transcript.end(), proofs[i].begin(), proofs[i].end() );
+      }
+      const auto seed = eosio::sha256( transcript.data(), transcript.size() ).extract_as_byte_array();
+
+      // r_i = low 128 bits of sha256(seed || i), little endian, well below the group order
+      std::vector<eosio::bls_scalar> scalars( count );
+      std::array<char, 32 + sizeof(uint32_t)> preimage;
+      std::memcpy( preimage.data(), seed.data(), 32 );
+      for( uint32_t i = 0; i < count; ++i ) {
+         std::memcpy( preimage.data() + 32, &i, sizeof(uint32_t) );
+         const auto digest = eosio::sha256( preimage.data(), preimage.size() ).extract_as_byte_array();
+         scalars[i].fill( 0 );
+         std::memcpy( scalars[i].data(), digest.data(), 16 );
+      }
+
+      // pair 0 carries all proofs, pairs 1..count the weighted keys and the hashes of the keys
+      std::vector<eosio::bls_g1> g1_points( count + 1 );
+      std::vector<eosio::bls_g2> g2_points( count + 1 );
+
+      g1_points[0] = eosio::G1_ONE_NEG;
+      eosio::check( eosio::bls_g2_weighted_sum( proofs.data(), scalars.data(), count, g2_points[0] ) == 0,
+                    "invalid proof of possession" );
+
+      for( uint32_t i = 0; i < count; ++i ) {
+         eosio::check( eosio::bls_g1_weighted_sum( &keys[i], &scalars[i], 1, g1_points[i + 1] ) == 0,
+                       "invalid finalizer key" );
+         eosio::g2_fromMessage( keys[i], eosio::POP_CIPHERSUITE_ID, g2_points[i + 1] );
+      }
+
+      eosio::bls_gt result;
+      eosio::check( eosio::bls_pairing( g1_points.data(), g2_points.data(), count + 1, result ) == 0,
+                    "bls pairing failed" );
+
+      return std::memcmp( result.data(), eosio::GT_ONE.data(), sizeof(eosio::bls_gt) ) == 0;
+   }
+
+} /// namespace eosiosystem
@@ -2,6 +2,7 @@
 
 #include <eosio/asset.hpp>
 #include <eosio/binary_extension.hpp>
+#include <eosio/crypto_bls_ext.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/producer_schedule.hpp>
 #include <eosio/singleton.hpp>
@@ -11,6 +12,7 @@
 
 #include <flon.system/native.hpp>
 
+#include <algorithm>
 #include <deque>
 #include <optional>
 #include <string>
@@ -107,6 +109,10 @@ namespace eosiosystem {
    static constexpr int64_t  ram_gift_bytes        = 1400;
    static constexpr int64_t  min_pervote_daily_pay = 100'0000;
    static constexpr uint32_t refund_delay_sec      = 3 * seconds_per_day;
+   static constexpr uint32_t max_vote_refund_tranches = 16;
+   static constexpr uint32_t max_refund_sweep_count = 100; // the most tranches one refundsweep settles
+   static constexpr int64_t  min_voter_votes       = 1'0000; // a voter holds none or at least this many votes
+   static constexpr uint32_t default_location_latency_ms = 200; // between distinct locations without a published latency
 
    static constexpr uint32_t ratio_boost           = 10000;
 
@@ -128,6 +134,7 @@ namespace eosiosystem {
 #ifdef ENABLE_VOTING_PRODUCER
    static constexpr uint32_t max_vote_producer_count     = 30;
    static constexpr uint32_t vote_interval_sec           = 1 * seconds_per_day;
+   static constexpr uint32_t max_batch_finalizer_keys    = 32;
 #endif
 
   /**
@@ -174,6 +181,8 @@ namespace eosiosystem {
    #endif//ENABLE_NAME_BID
 
    // Defines new global state parameters.
+   // The election and reward fields have moved to `global2` (eosio_global_state2), they are read
+   // once to migrate them there and then zeroed; they are kept here to preserve the row layout.
    struct [[eosio::table("global"), eosio::contract("flon.system")]] eosio_global_state : eosio::blockchain_parameters {
       uint64_t free_ram()const { return max_ram_size - total_ram_bytes_reserved; }
 
@@ -203,6 +212,26 @@ namespace eosiosystem {
                                 (last_name_close)(revision) )
    };
 
+   // Defines the frequently updated global state, split from the `global` singleton so that
+   // onblock and voting actions neither load nor reserialize the blockchain parameters.
+   struct [[eosio::table("global2"), eosio::contract("flon.system")]] eosio_global_state2 {
+      asset                total_vote_stake;                   /// total staked votes, its symbol is the core symbol
+      time_point           election_activated_time;            /// election activated time
+      time_point           reward_started_time;                /// reward started time
+      asset                initial_rewards_per_block;          /// initial reward per block
+      asset                total_produced_rewards;             /// total produced rewards
+      asset                total_unclaimed_rewards;            /// all rewards which have been produced but not paid
+      uint16_t             last_producer_schedule_size = 0;
+      block_timestamp      last_producer_schedule_update;
+      block_timestamp      last_name_close;
+      uint8_t              revision = 0; ///< used to track version updates in the future.
+
+      EOSLIB_SERIALIZE( eosio_global_state2, (total_vote_stake)(election_activated_time)(reward_started_time)
+                                             (initial_rewards_per_block)(total_produced_rewards)(total_unclaimed_rewards)
+                                             (last_producer_schedule_size)(last_producer_schedule_update)
+                                             (last_name_close)(revision) )
+   };
+
    inline eosio::block_signing_authority convert_to_block_signing_authority( const eosio::public_key& producer_key ) {
       return eosio::block_signing_authority_v0{ .threshold = 1, .keys = {{producer_key, 1}} };
    }
@@ -312,10 +341,33 @@ namespace eosiosystem {
       EOSLIB_SERIALIZE( finalizer_auth_info, (key_id)(fin_authority) )
    };
 
-   // A single entry storing information about last proposed finalizers.
-   // Should avoid  using the global singleton pattern as it unnecessarily
-   // serializes data at construction/desstruction of system_contract,
-   // even if the data is not used.
+   // finalizer_key_pop is a finalizer key to register together with its proof of possession
+   struct finalizer_key_pop {
+      std::string finalizer_key;       // finalizer key in base64url format
+      std::string proof_of_possession; // proof of possession signature of finalizer_key in base64url format
+
+      EOSLIB_SERIALIZE( finalizer_key_pop, (finalizer_key)(proof_of_possession) )
+   };
+
+   // gas_purchase is one receiver of a batchbuygas action
+   struct gas_purchase {
+      name  receiver; // the gas receiver
+      asset quant;    // the quantity of tokens to buy gas with for receiver
+
+      EOSLIB_SERIALIZE( gas_purchase, (receiver)(quant) )
+   };
+
+   // account_limits is one account of a batchalimits action
+   struct account_limits {
+      name     account;      // the account whose resource limits to be set
+      uint64_t gas;          // the reserved gas to be set
+      bool     is_unlimited; // whether the account has unlimited resources
+
+      EOSLIB_SERIALIZE( account_limits, (account)(gas)(is_unlimited) )
+   };
+
+   // Legacy single entry storing the full last proposed finalizer policy.
+   // Replaced by last_prop_fin_digest_info, it is moved there by the next producer schedule update.
    struct [[eosio::table("lastpropfins"), eosio::contract("flon.system")]] last_prop_finalizers_info {
       std::vector<finalizer_auth_info> last_proposed_finalizers; // sorted by ascending finalizer key id
 
@@ -326,6 +378,24 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "lastpropfins"_n, last_prop_finalizers_info >  last_prop_fins_table;
 
+   // A single entry storing information about last proposed finalizers.
+   // Only the digest of the policy and its key ids are kept, so that checking
+   // for an unchanged policy on every schedule update reads a few hundred bytes;
+   // the authorities are rebuilt from finalizer_keys_table when needed.
+   // Should avoid  using the global singleton pattern as it unnecessarily
+   // serializes data at construction/desstruction of system_contract,
+   // even if the data is not used.
+   struct [[eosio::table("lastpropdgst"), eosio::contract("flon.system")]] last_prop_fin_digest_info {
+      checksum256           digest;  // sha256 of the (key id, public key) pairs of the policy
+      std::vector<uint64_t> key_ids; // sorted by ascending finalizer key id
+
+      uint64_t primary_key()const { return 0; }
+
+      EOSLIB_SERIALIZE( last_prop_fin_digest_info, (digest)(key_ids) )
+   };
+
+   typedef eosio::multi_index< "lastpropdgst"_n, last_prop_fin_digest_info >  last_prop_fin_digest_table;
+
    // A single entry storing next available finalizer key_id to make sure
    // key_id in finalizers_table will never be reused.
    struct [[eosio::table("finkeyidgen"), eosio::contract("flon.system")]] fin_key_id_generator_info {
@@ -337,6 +407,66 @@ namespace eosiosystem {
 
    typedef eosio::multi_index< "finkeyidgen"_n, fin_key_id_generator_info >  fin_key_id_gen_table;
 
+   // A single entry caching the elected (top 21) producer set of the last schedule update.
+   // `vote_generation` is bumped by any vote or producer change that may alter the
+   // membership of the elected set; `update_elected_producers` only walks the producer
+   // vote index again when `elected_generation` is behind it.
+   struct [[eosio::table("electedprods"), eosio::contract("flon.system")]] elected_producers_info {
+      uint64_t          vote_generation    = 0; // bumped when the elected set may have changed
+      uint64_t          elected_generation = 0; // vote_generation the elected set was computed at
+      int64_t           min_elected_votes  = 0; // lower bound of total_votes within the elected set
+      std::vector<name> elected_producers;      // sorted by producer name
+
+      uint64_t primary_key()const { return 0; }
+
+      bool is_dirty()const { return vote_generation != elected_generation; }
+      bool is_elected( const name& producer )const {
+         return std::binary_search( elected_producers.begin(), elected_producers.end(), producer );
+      }
+
+      EOSLIB_SERIALIZE( elected_producers_info, (vote_generation)(elected_generation)(min_elected_votes)(elected_producers) )
+   };
+
+   typedef eosio::multi_index< "electedprods"_n, elected_producers_info >  elected_producers_table;
+
+   // Block propagation latency between producers at two locations, published by governance
+   // and used to order the producer schedule. `location_a` is the lower of the two locations.
+   struct [[eosio::table("latency"), eosio::contract("flon.system")]] location_latency {
+      uint16_t          location_a = 0;
+      uint16_t          location_b = 0;
+      uint32_t          latency_ms = 0;
+
+      uint64_t primary_key()const { return uint64_t(location_a) << 16 | location_b; }
+
+      EOSLIB_SERIALIZE( location_latency, (location_a)(location_b)(latency_ms) )
+   };
+
+   typedef eosio::multi_index< "latency"_n, location_latency >  location_latency_table;
+
+   // Number of blocks a producer has produced since the last settlement
+   struct produced_blocks_info {
+      name              producer;
+      uint32_t          blocks = 0;
+
+      EOSLIB_SERIALIZE( produced_blocks_info, (producer)(blocks) )
+   };
+
+   // A single entry counting the blocks produced within the current schedule round.
+   // onblock only bumps a counter here; the block rewards are settled into `producer_info`
+   // and the global reward totals once per schedule update.
+   // `rewards_per_block` caches the halved block reward of `reward_period`.
+   struct [[eosio::table("prodround"), eosio::contract("flon.system")]] production_round_info {
+      int64_t                            reward_period     = -1; // halving period of rewards_per_block, -1 if not computed
+      int64_t                            rewards_per_block = 0;  // block reward amount of reward_period
+      std::vector<produced_blocks_info>  produced_blocks;        // unsettled blocks, in order of first production
+
+      uint64_t primary_key()const { return 0; }
+
+      EOSLIB_SERIALIZE( production_round_info, (reward_period)(rewards_per_block)(produced_blocks) )
+   };
+
+   typedef eosio::multi_index< "prodround"_n, production_round_info >  production_round_table;
+
    // Voter info. Voter info stores information about the voter:
    // - `owner` the voter
    // - `producers` the producers approved by this voter
@@ -360,6 +490,7 @@ namespace eosiosystem {
    #endif//ENABLE_VOTING_PRODUCER
 
    typedef eosio::singleton< "global"_n, eosio_global_state >   global_state_singleton;
+   typedef eosio::singleton< "global2"_n, eosio_global_state2 > global_state2_singleton;
 
    #ifdef ENABLE_VOTING_PRODUCER
    struct [[eosio::table, eosio::contract("flon.system")]] vote_refund {
@@ -374,6 +505,61 @@ namespace eosiosystem {
    };
 
    typedef eosio::multi_index< "voterefund"_n, vote_refund >      vote_refund_table;
+
+   // A tranche of subtracted votes waiting out `refund_delay_sec`, one per `subvote`.
+   // Tranches are settled lazily by the voter's next addvote/subvote/voterefund or by refundsweep.
+   struct [[eosio::table, eosio::contract("flon.system")]] vote_refund_tranche {
+      uint64_t        id;
+      name            owner;
+      time_point_sec  request_time;
+      eosio::asset    vote_staked;
+
+      uint64_t  primary_key()const { return id; }
+      uint64_t  by_owner()const { return owner.value; }
+      uint64_t  by_request_time()const { return request_time.sec_since_epoch(); }
+
+      // explicit serialization macro is not necessary, used here only to improve compilation time
+      EOSLIB_SERIALIZE( vote_refund_tranche, (id)(owner)(request_time)(vote_staked) )
+   };
+
+   typedef eosio::multi_index< "refundqueue"_n, vote_refund_tranche,
+                               indexed_by<"byowner"_n, const_mem_fun<vote_refund_tranche, uint64_t, &vote_refund_tranche::by_owner> >,
+                               indexed_by<"byreqtime"_n, const_mem_fun<vote_refund_tranche, uint64_t, &vote_refund_tranche::by_request_time> >
+                             > vote_refund_queue;
+
+   // A producer returned by the getproducers read-only action
+   struct producer_vote_info {
+      name            owner;
+      int64_t         total_votes  = 0;
+      uint16_t        location     = 0;
+      bool            is_elected   = false; ///< elected by the last election
+      bool            is_finalizer = false; ///< has an active finalizer key
+
+      EOSLIB_SERIALIZE( producer_vote_info, (owner)(total_votes)(location)(is_elected)(is_finalizer) )
+   };
+
+   // A pending vote refund returned by the getvoter read-only action
+   struct pending_vote_refund {
+      time_point_sec  request_time;
+      eosio::asset    vote_staked;
+      bool            is_matured = false; ///< paid out by the next voterefund
+
+      EOSLIB_SERIALIZE( pending_vote_refund, (request_time)(vote_staked)(is_matured) )
+   };
+
+   // The election state of a voter returned by the getvoter read-only action,
+   // combined from its voter rows in flon.system and flon.reward
+   struct voter_state {
+      name                             owner;
+      int64_t                          votes = 0;
+      std::vector<name>                producers;
+      block_timestamp                  last_unvoted_time;
+      eosio::asset                     unclaimed_rewards; ///< including the rewards flon.reward has not settled yet
+      eosio::asset                     claimed_rewards;
+      std::vector<pending_vote_refund> refunds;           ///< oldest first
+
+      EOSLIB_SERIALIZE( voter_state, (owner)(votes)(producers)(last_unvoted_time)(unclaimed_rewards)(claimed_rewards)(refunds) )
+   };
    #endif//ENABLE_VOTING_PRODUCER
 
 
@@ -386,16 +572,6 @@ namespace eosiosystem {
 
    typedef eosio::singleton< "prodconf"_n, producing_config >   producing_config_singleton;
 
-   /**
-    * The `flon.system` smart contract is provided by `block.one` as a sample system contract, and it defines the structures and actions needed for blockchain's core functionality.
-    *
-    * Just like in the `flon.bios` sample contract implementation, there are a few actions which are not implemented at the contract level (`newaccount`, `updateauth`, `deleteauth`, `linkauth`, `unlinkauth`, `canceldelay`, `onerror`, `setabi`, `setcode`), they are just declared in the contract so they will show in the contract's ABI and users will be able to push those actions to the chain via the account holding the `flon.system` contract, but the implementation is at the FULLON core level. They are referred to as FULLON native actions.
-    *
-    * - Users can buy gas, stake tokens for voting, and vote for producers.
-    * - Producers register in order to be voted for, and can claim per-block and per-vote rewards.
-    * - Users can buy and sell RAM at a market-determined price.
-    * - Users can bid on premium names.
-    */
    class [[eosio::contract("flon.system")]] system_contract : public native {
 
       private:
@@ -406,11 +582,20 @@ namespace eosiosystem {
          finalizer_keys_table     _finalizer_keys;
          finalizers_table         _finalizers;
          last_prop_fins_table     _last_prop_finalizers;
-         std::optional<std::vector<finalizer_auth_info>> _last_prop_finalizers_cached;
+         last_prop_fin_digest_table _last_prop_fin_digest;
+         std::optional<last_prop_fin_digest_info> _last_prop_fin_digest_cached;
          fin_key_id_gen_table     _fin_key_id_generator;
+         elected_producers_table  _elected_producers;
+         std::optional<elected_producers_info> _elected_producers_cached;
+         production_round_table   _production_round;
+         std::optional<production_round_info> _production_round_cached;
          #endif//ENABLE_VOTING_PRODUCER
          global_state_singleton   _global;
-         eosio_global_state       _gstate;
+         std::optional<eosio_global_state>  _gstate;     // loaded on first use
+         bool                     _gstate_dirty  = false;
+         global_state2_singleton  _global2;
+         std::optional<eosio_global_state2> _gstate2;    // loaded on first use
+         bool                     _gstate2_dirty = false;
 
       public:
          static constexpr eosio::name active_permission     = {"active"_n};
@@ -431,14 +616,16 @@ namespace eosiosystem {
           // Returns the core symbol by system account name
           // @param system_account - the system account to get the core symbol for.
          static eosio::symbol get_core_symbol(const name& self) {
-            global_state_singleton   global(self, self.value);
-            check(global.exists(), "global does not exist");
-            auto sym = global.get().total_vote_stake.symbol;
+            auto sym = get_total_vote_stake(self).symbol;
             check(sym.raw() != 0, "system contract must first be initialized");
             return sym;
          }
 
          inline static bool is_init(const name& self) {
+            global_state2_singleton  global2(self, self.value);
+            if( global2.exists() ) {
+               return global2.get().total_vote_stake.symbol.is_valid();
+            }
             global_state_singleton   global(self, self.value);
             return global.exists() && global.get().total_vote_stake.symbol.is_valid();
          }
@@ -522,6 +709,18 @@ namespace eosiosystem {
          [[eosio::action]]
          void setalimits( const name& account, uint64_t gas, bool is_unlimited );
 
+         /**
+          * Batch set account limits action sets the resource limits of many accounts at once,
+          * each entry is applied as a `setalimits` action would be.
+          *
+          * @param limits - the accounts and their resource limits to be set.
+          *
+          * @pre `limits` is not empty
+          * @pre every account exists and its limits change
+          */
+         [[eosio::action]]
+         void batchalimits( const std::vector<account_limits>& limits );
+
          /**
           * The activate action, activates a protocol feature
           *
@@ -550,6 +749,20 @@ namespace eosiosystem {
          [[eosio::action]]
          void buygas( const name& payer, const name& receiver, const asset& quant );
 
+         /**
+          * Batch buy gas action, increases the gas quota of many receivers paid by one payer.
+          * The payer makes a single transfer of the total quantity to the gas account, then each
+          * receiver's gas quota is increased by its own quantity, as a `buygas` action would.
+          *
+          * @param payer - the gas buyer,
+          * @param purchases - the receivers and the quantities of tokens to buy gas with for them.
+          *
+          * @pre `purchases` is not empty
+          * @pre Every quantity is a positive core asset and every receiver exists
+          */
+         [[eosio::action]]
+         void batchbuygas( const name& payer, const std::vector<gas_purchase>& purchases );
+
          /**
           * The buygasself action is designed to enhance the permission security by allowing an account to purchase GAS exclusively for itself.
           * This action prevents the potential risk associated with standard actions like buygas,
@@ -564,13 +777,58 @@ namespace eosiosystem {
          #ifdef ENABLE_VOTING_PRODUCER
          /**
           * Refund vote action, this action is called after the subvote-period to claim all pending
-          * staked core asset of substracted votes belonging to owner.
+          * staked core asset of substracted votes belonging to owner. Anyone may call it.
           *
           * @param owner - the owner of the tokens claimed.
           */
          [[eosio::action]]
          void voterefund( const name& owner );
 
+         /**
+          * Refund sweep action, pays out up to `max_count` matured vote refund tranches of any voters,
+          * oldest first. Anyone may call it. Consecutive tranches of the same voter are paid out in one transfer.
+          *
+          * @param max_count - the maximum number of tranches to settle, at most `max_refund_sweep_count`.
+          */
+         [[eosio::action]]
+         void refundsweep( uint32_t max_count );
+
+         /**
+          * Set latency action, publishes the block propagation latency between producers at two locations.
+          * The producer schedule is ordered to keep the latency between consecutive producers low,
+          * and is reordered at the next schedule update.
+          *
+          * @param location_a - a producer location, the ISO 3166 country code used by regproducer,
+          * @param location_b - another producer location,
+          * @param latency_ms - the latency in milliseconds, zero removes the published latency.
+          *
+          * @pre Requires authority of the contract
+          */
+         [[eosio::action]]
+         void setlatency( uint16_t location_a, uint16_t location_b, uint32_t latency_ms );
+
+         /**
+          * Get producers action returns the top active producers by votes, with their election
+          * and finalizer status.
+          *
+          * @param limit - the maximum number of producers to return.
+          *
+          * @return the active producers, most voted first
+          */
+         [[eosio::action, eosio::read_only]]
+         std::vector<producer_vote_info> getproducers( uint32_t limit );
+
+         /**
+          * Get voter action returns the election state of a voter in one call: its votes and voted producers,
+          * its rewards in flon.reward, with the unclaimed rewards computed up to now, and its pending vote refunds.
+          *
+          * @param voter - the voter account.
+          *
+          * @return the state of `voter`
+          */
+         [[eosio::action, eosio::read_only]]
+         voter_state getvoter( const name& voter );
+
          // functions defined in voting.cpp
 
          /**
@@ -649,6 +907,23 @@ namespace eosiosystem {
          [[eosio::action]]
          void regfinkey( const name& finalizer_name, const std::string& finalizer_key, const std::string& proof_of_possession);
 
+         /**
+          * Action to register several finalizer keys of a registered producer at once.
+          * Behaves as `regfinkey` on each key, but all proofs of possession are verified
+          * together by a single multi-pairing, which is much cheaper than one check per key.
+          * If any key fails, none of them is registered.
+          *
+          * @param finalizer_name - account registering the keys,
+          * @param finalizer_keys - keys to be registered, each with its proof of possession, both in base64url format.
+          *
+          * @pre `finalizer_name` must be a registered producer
+          * @pre `finalizer_keys` must hold 1 to `max_batch_finalizer_keys` keys, none registered before nor repeated
+          * @pre every proof of possession must be valid
+          * @pre Authority of `finalizer_name` to register.
+          */
+         [[eosio::action]]
+         void regfinkeys( const name& finalizer_name, const std::vector<finalizer_key_pop>& finalizer_keys );
+
          /**
           * Action to activate a finalizer key. If the finalizer is currently an
           * active block producer (in top 21), then immediately change Finalizer Policy.
@@ -729,6 +1004,7 @@ namespace eosiosystem {
           *
           * @pre Voter must authorize this action
           * @pre Voter must have enough core asset to stake for adding votes
+          * @pre Voter must hold at least `min_voter_votes` votes after adding
           * @pre Voter can only update votes once a day, restricted actions: (addvote, subvote, vote)
           *
           * @post All producers `voter` account has voted for will have their votes updated immediately.
@@ -745,13 +1021,14 @@ namespace eosiosystem {
           *
           * @pre Voter must authorize this action
           * @pre Voter must have enough votes to substract
-          * @pre Voter can only have one substracted votes at a time (including processing of delayed refunds)
+          * @pre Voter must hold no votes or at least `min_voter_votes` votes after substracting
+          * @pre Voter can have at most `max_vote_refund_tranches` pending refunds, matured ones are settled first
           * @pre Voter can only update votes once a day, restricted actions: (addvote, subvote, vote)
           *
-          * @post The substracting staked will be transferred to `voter` liquid balance via a
-          *    deferred `voterefund` transaction with a delay of 3 days.
+          * @post The substracting staked is queued as a refund tranche, transferred to `voter` liquid balance
+          *    by the first addvote, subvote, voterefund or refundsweep at least 3 days later.
           * @post All producers `voter` account has voted for will have their votes updated immediately.
-          * @post Bandwidth and storage for the deferred transaction are billed to `voter`.
+          * @post Storage for the refund tranche is billed to `voter`.
           */
          [[eosio::action]]
          void subvote( const name& voter, const asset& vote_staked );
@@ -894,6 +1171,7 @@ namespace eosiosystem {
          using activate_action = eosio::action_wrapper<"activate"_n, &system_contract::activate>;
          using logsystemfee_action = eosio::action_wrapper<"logsystemfee"_n, &system_contract::logsystemfee>;
          using buygas_action = eosio::action_wrapper<"buygas"_n, &system_contract::buygas>;
+         using batchbuygas_action = eosio::action_wrapper<"batchbuygas"_n, &system_contract::batchbuygas>;
          #ifdef ENABLE_VOTING_PRODUCER
          using regproducer_action = eosio::action_wrapper<"regproducer"_n, &system_contract::regproducer>;
          using regproducer2_action = eosio::action_wrapper<"regproducer2"_n, &system_contract::regproducer2>;
@@ -902,6 +1180,8 @@ namespace eosiosystem {
          // using voteupdate_action = eosio::action_wrapper<"voteupdate"_n, &system_contract::voteupdate>;
          using claimrewards_action = eosio::action_wrapper<"claimrewards"_n, &system_contract::claimrewards>;
          using rmvproducer_action = eosio::action_wrapper<"rmvproducer"_n, &system_contract::rmvproducer>;
+         using getproducers_action = eosio::action_wrapper<"getproducers"_n, &system_contract::getproducers>;
+         using getvoter_action = eosio::action_wrapper<"getvoter"_n, &system_contract::getvoter>;
          #endif//ENABLE_VOTING_PRODUCER
          #ifdef ENABLE_NAME_BID
          using bidname_action = eosio::action_wrapper<"bidname"_n, &system_contract::bidname>;
@@ -909,6 +1189,7 @@ namespace eosiosystem {
          #endif//ENABLE_NAME_BID
          using setpriv_action = eosio::action_wrapper<"setpriv"_n, &system_contract::setpriv>;
          using setalimits_action = eosio::action_wrapper<"setalimits"_n, &system_contract::setalimits>;
+         using batchalimits_action = eosio::action_wrapper<"batchalimits"_n, &system_contract::batchalimits>;
          using setparams_action = eosio::action_wrapper<"setparams"_n, &system_contract::setparams>;
          // using cfgreward_action = eosio::action_wrapper<"cfgreward"_n, &system_contract::cfgreward>;
          using setibintervl_action = eosio::action_wrapper<"setibintervl"_n, &system_contract::setibintervl>;
@@ -916,24 +1197,44 @@ namespace eosiosystem {
       private:
          // Implementation details:
 
-         const eosio::symbol& core_symbol() const {
-            const auto& core_symbol = _gstate.total_vote_stake.symbol;
+         const eosio::symbol& core_symbol() {
+            const auto& core_symbol = get_gstate2().total_vote_stake.symbol;
             check(core_symbol.is_valid(), "system contract must first be initialized");
             return core_symbol;
          }
 
-         inline bool is_init() const {
-            return _gstate.total_vote_stake.symbol.is_valid();
+         inline bool is_init() {
+            return get_gstate2().total_vote_stake.symbol.is_valid();
          }
 
-         inline void check_init() const {
+         inline void check_init() {
             check(is_init(), "system contract must first be initialized");
          }
 
+         // Returns the total vote stake, migrated from the `global` singleton if `global2` does not exist yet
+         static asset get_total_vote_stake(const name& self) {
+            global_state2_singleton  global2(self, self.value);
+            if( global2.exists() ) {
+               return global2.get().total_vote_stake;
+            }
+            global_state_singleton   global(self, self.value);
+            check(global.exists(), "global does not exist");
+            return global.get().total_vote_stake;
+         }
+
 
          //defined in flon.system.cpp
          static eosio_global_state get_default_parameters();
+         const eosio_global_state& get_gstate();
+         eosio_global_state& mutable_gstate();
+         const eosio_global_state2& get_gstate2();
+         eosio_global_state2& mutable_gstate2();
          void channel_to_system_fees( const name& from, const asset& amount );
+         void set_account_limits( const name& account, uint64_t gas, bool is_unlimited );
+
+         // defined in delegate_bandwidth.cpp
+         void check_gas_purchase( const name& payer, const name& receiver, const asset& quant );
+         void add_reserved_gas( const name& receiver, const asset& quant );
 
 
          #ifdef ENABLE_VOTING_PRODUCER
@@ -943,12 +1244,27 @@ namespace eosiosystem {
          void update_elected_producers( const block_timestamp& timestamp );
          void update_producer_votes( const std::vector<name>& producers, int64_t votes_delta,
                                              bool is_adding);
+         const elected_producers_info& get_elected_producers();
+         void save_elected_producers( elected_producers_info info );
+         void mark_elected_producers_dirty();
+         void check_elected_producers( const producer_info& prod, bool may_leave );
+         asset settle_vote_refunds( const name& owner );
+         std::vector<std::vector<uint32_t>> get_location_latencies( const std::vector<uint16_t>& locations );
+
+         // defined in producer_pay.cpp
+         const production_round_info& get_production_round();
+         void save_production_round( production_round_info info );
+         void count_produced_block( const name& producer, const time_point& now );
+         void settle_produced_blocks( bool reset_rewards_per_block = false );
 
          // defined in finalizer_key.cpp
          bool is_savanna_consensus();
          void set_proposed_finalizers( std::vector<finalizer_auth_info> finalizers );
-         const std::vector<finalizer_auth_info>& get_last_proposed_finalizers();
+         const last_prop_fin_digest_info& get_last_proposed_digest();
+         void migrate_last_proposed_finalizers();
+         std::optional<std::vector<finalizer_auth_info>> get_last_proposed_finalizers();
          uint64_t get_next_finalizer_key_id();
+         void add_finalizer_key( const producer_info& producer, const std::string& finalizer_key, const eosio::bls_g1& fin_key_g1 );
          finalizers_table::const_iterator get_finalizer_itr( const name& finalizer_name ) const;
 
          #endif//ENABLE_VOTING_PRODUCER
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace eosiosystem {
+
+   /**
+    * Orders a producer schedule so that consecutive producers hand off blocks with a low latency.
+    *
+    * The schedule is a cycle, the last producer hands off to the first one. The order is built greedily,
+    * each producer followed by its nearest unscheduled one, then improved by at most `max_passes` passes
+    * of 2-opt, which reverse a run of the schedule whenever that strictly lowers the total latency.
+    * The cost is O(n^2) per pass. Ties resolve towards the lower index, so the result only depends on
+    * `latency` and the input order.
+    *
+    * @param latency - symmetric latency between producers `i` and `j` in any unit, `latency[i][i]` is ignored
+    * @param max_passes - the maximum number of 2-opt passes
+    *
+    * @return the indexes of the producers in schedule order, starting with 0
+    */
+   inline std::vector<uint32_t> order_by_latency( const std::vector<std::vector<uint32_t>>& latency, uint32_t max_passes = 4 ) {
+      const uint32_t n = latency.size();
+      std::vector<uint32_t> order;
+      order.reserve( n );
+      if( n == 0 ) {
+         return order;
+      }
+
+      std::vector<bool> scheduled( n, false );
+      order.push_back( 0 );
+      scheduled[0] = true;
+      while( order.size() < n ) {
+         const auto& from = latency[order.back()];
+         uint32_t next = n;
+         for( uint32_t j = 0; j < n; ++j ) {
+            if( !scheduled[j] && (next == n || from[j] < from[next]) ) {
+               next = j;
+            }
+         }
+         order.push_back( next );
+         scheduled[next] = true;
+      }
+
+      if( n < 4 ) {
+         return order; // every cycle of 3 producers has the same latency
+      }
+      for( uint32_t pass = 0; pass < max_passes; ++pass ) {
+         bool improved = false;
+         for( uint32_t i = 0; i + 2 < n; ++i ) {
+            const uint32_t a = order[i], b = order[i + 1];
+            for( uint32_t j = i + 2; j < n; ++j ) {
+               if( i == 0 && j == n - 1 ) {
+                  continue; // both edges touch order[0]
+               }
+               const uint32_t c = order[j], d = order[(j + 1) % n];
+               const int64_t delta = int64_t(latency[a][c]) + latency[b][d] - latency[a][b] - latency[c][d];
+               if( delta < 0 ) {
+                  std::reverse( order.begin() + i + 1, order.begin() + j + 1 );
+                  improved = true;
+                  break;
+               }
+            }
+         }
+         if( !improved ) {
+            break;
+         }
+      }
+      return order;
+   }
+
+} /// namespace eosiosystem
@@ -22,25 +22,27 @@ void system_contract::add_to_blockinfo_table(const eosio::checksum256&    previo
 
    block_info::block_info_table t(get_self(), 0);
 
-   if (block_info::rolling_window_size > 0) {
-      // Add new entry to blockinfo table for the new block.
-      t.emplace(get_self(), [&](block_info::block_info_record& r) {
+   // Overwrite the slot of the new block, which holds the record of the block that fell out of the rolling window.
+   auto itr = t.find(block_info::block_info_slot(new_block_height));
+   if (itr != t.end()) {
+      t.modify(itr, same_payer, [&](block_info::block_info_record& r) {
+         r.version         = 0;
          r.block_height    = new_block_height;
          r.block_timestamp = new_block_timestamp;
       });
+      return;
    }
 
-   // Erase up to two entries that have fallen out of the rolling window.
-
-   const uint32_t last_prunable_block_height =
-      std::max(new_block_height, block_info::rolling_window_size) - block_info::rolling_window_size;
+   t.emplace(get_self(), [&](block_info::block_info_record& r) {
+      r.block_height    = new_block_height;
+      r.block_timestamp = new_block_timestamp;
+   });
 
+   // The ring buffer is still being filled. Erase up to two records keyed by block height written before the table
+   // became a ring buffer, they are all gone by the time every slot is in use.
    int count = 2;
-   for (auto itr = t.begin(), end = t.end();                                        //
-        itr != end && itr->block_height <= last_prunable_block_height && 0 < count; //
-        --count)                                                                    //
-   {
-      itr = t.erase(itr);
+   for (auto legacy_itr = t.lower_bound(block_info::rolling_window_size); legacy_itr != t.end() && 0 < count; --count) {
+      legacy_itr = t.erase(legacy_itr);
    }
 }
 
@@ -34,13 +34,7 @@ namespace eosiosystem {
    void system_contract::buygas( const name& payer, const name& receiver, const asset& quant )
    {
       require_auth( payer );
-
-      // core_symbol() will check system contract is_init()
-      check( quant.symbol == core_symbol(), "must buy gas with core asset" );
-      check( quant.amount > 0, "must purchase a positive amount" );
-      check( is_account(receiver), "receiver account not exists" );
-      check( payer != gas_account && receiver != gas_account, "neither payer nor receiver can be system gas account" );
-      // TODO: limit the max quant?
+      check_gas_purchase( payer, receiver, quant );
 
       //TODO: fee of buygas?
       // asset fee = quant;
@@ -61,6 +55,44 @@ namespace eosiosystem {
       //    transfer_act.send( payer, gasfee_account, fee, "gas fee" );
       //    channel_to_system_fees( gasfee_account, fee );
       // }
+      add_reserved_gas( receiver, quant );
+   }
+
+   /**
+    *  The payer transfers the total quantity of all purchases to the gas account at once, then every receiver
+    *  gets its own quantity added to its gas quota. A receiver may appear more than once.
+    */
+   void system_contract::batchbuygas( const name& payer, const std::vector<gas_purchase>& purchases )
+   {
+      require_auth( payer );
+      check( !purchases.empty(), "purchases cannot be empty" );
+
+      asset total( 0, core_symbol() );
+      for( const auto& p : purchases ) {
+         check_gas_purchase( payer, p.receiver, p.quant );
+         check( asset::max_amount - total.amount >= p.quant.amount, "Overflow when calculating total quantity" );
+         total += p.quant;
+      }
+
+      {
+         token::transfer_action transfer_act{ token_account, { {payer, active_permission}, {gas_account, active_permission} } };
+         transfer_act.send( payer, gas_account, total, "buy gas" );
+      }
+      for( const auto& p : purchases ) {
+         add_reserved_gas( p.receiver, p.quant );
+      }
+   }
+
+   void system_contract::check_gas_purchase( const name& payer, const name& receiver, const asset& quant ) {
+      // core_symbol() will check system contract is_init()
+      check( quant.symbol == core_symbol(), "must buy gas with core asset" );
+      check( quant.amount > 0, "must purchase a positive amount" );
+      check( is_account(receiver), "receiver account not exists" );
+      check( payer != gas_account && receiver != gas_account, "neither payer nor receiver can be system gas account" );
+      // TODO: limit the max quant?
+   }
+
+   void system_contract::add_reserved_gas( const name& receiver, const asset& quant ) {
       uint64_t reserved_gas = 0;
       bool is_unlimited = true;
       eosio::get_resource_limits( receiver, reserved_gas, is_unlimited );
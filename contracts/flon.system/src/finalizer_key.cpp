@@ -1,7 +1,10 @@
 #include <flon.system/flon.system.hpp>
+#include <flon.system/bls_pop.hpp>
 
 #include <eosio/eosio.hpp>
 
+#include <set>
+
 namespace eosiosystem {
    #ifdef ENABLE_VOTING_PRODUCER
    finalizer_auth_info::finalizer_auth_info(const finalizer_info& finalizer)
@@ -15,7 +18,18 @@ namespace eosiosystem {
 
    // Returns true if nodeos has transitioned to Savanna (having last proposed finalizers)
    bool system_contract::is_savanna_consensus() {
-      return !get_last_proposed_finalizers().empty();
+      return !get_last_proposed_digest().key_ids.empty();
+   }
+
+   // Returns hash of the (key id, public key) pairs of finalizers sorted by key id
+   static eosio::checksum256 get_finalizers_digest(const std::vector<finalizer_auth_info>& finalizers) {
+      std::vector<char> data;
+      for( const auto& f: finalizers ) {
+         const auto* id = reinterpret_cast<const char*>(&f.key_id);
+         data.insert(data.end(), id, id + sizeof(f.key_id));
+         data.insert(data.end(), f.fin_authority.public_key.begin(), f.fin_authority.public_key.end());
+      }
+      return eosio::sha256(data.data(), data.size());
    }
 
    // Validates finalizer_key in text form and returns a binary form
@@ -55,18 +69,23 @@ namespace eosiosystem {
          return lhs.key_id < rhs.key_id;
       } );
 
-      // Compare with last_proposed_finalizers to see if finalizers have changed.
-      const auto& last_proposed_finalizers = get_last_proposed_finalizers();
-      if( proposed_finalizers == last_proposed_finalizers ) {
+      // Compare with the digest of last proposed finalizers to see if finalizers have changed.
+      const auto digest = get_finalizers_digest(proposed_finalizers);
+      const auto& last_proposed = get_last_proposed_digest();
+      if( proposed_finalizers.size() == last_proposed.key_ids.size() &&
+          ( proposed_finalizers.empty() || digest == last_proposed.digest ) ) {
          // Finalizer policy has not changed. Do not proceed.
          return;
       }
 
       // Construct finalizer authorities
+      last_prop_fin_digest_info new_proposed { .digest = digest };
+      new_proposed.key_ids.reserve(proposed_finalizers.size());
       std::vector<eosio::finalizer_authority> finalizer_authorities;
       finalizer_authorities.reserve(proposed_finalizers.size());
-      for( const auto& k: proposed_finalizers ) {
-         finalizer_authorities.emplace_back(k.fin_authority);
+      for( auto& k: proposed_finalizers ) {
+         new_proposed.key_ids.push_back(k.key_id);
+         finalizer_authorities.emplace_back(std::move(k.fin_authority));
       }
 
       // Establish new finalizer policy
@@ -79,37 +98,82 @@ namespace eosiosystem {
       eosio::set_finalizers(std::move(fin_policy)); // call host function
 
       // Store last proposed policy in both cache and DB table
-      auto itr = _last_prop_finalizers.begin();
-      if( itr == _last_prop_finalizers.end() ) {
-         _last_prop_finalizers.emplace( get_self(), [&]( auto& f ) {
-            f.last_proposed_finalizers = proposed_finalizers;
+      auto itr = _last_prop_fin_digest.begin();
+      if( itr == _last_prop_fin_digest.end() ) {
+         _last_prop_fin_digest.emplace( get_self(), [&]( auto& f ) {
+            f = new_proposed;
          });
       } else {
-         _last_prop_finalizers.modify(itr, same_payer, [&]( auto& f ) {
-            f.last_proposed_finalizers = proposed_finalizers;
+         _last_prop_fin_digest.modify(itr, same_payer, [&]( auto& f ) {
+            f = new_proposed;
          });
       }
-      // Ensure not invalidate anyone holding the references to the vector
-      // that was returned earlier by get_last_proposed_finalizer
-      if (_last_prop_finalizers_cached.has_value()) {
-         std::swap(*_last_prop_finalizers_cached, proposed_finalizers);
-      } else {
-         _last_prop_finalizers_cached.emplace(std::move(proposed_finalizers));
-      }
+      _last_prop_fin_digest_cached = std::move(new_proposed);
    }
 
-   // Returns last proposed finalizers
-   const std::vector<finalizer_auth_info>& system_contract::get_last_proposed_finalizers() {
-      if( !_last_prop_finalizers_cached.has_value() ) {
-         const auto finalizers_itr = _last_prop_finalizers.begin();
-         if( finalizers_itr == _last_prop_finalizers.end() ) {
-            _last_prop_finalizers_cached = {};
+   // Returns the digest of the last proposed finalizers. It only reads the tables: until
+   // migrate_last_proposed_finalizers has run, it is derived from the full policy stored by previous versions.
+   const last_prop_fin_digest_info& system_contract::get_last_proposed_digest() {
+      if( !_last_prop_fin_digest_cached.has_value() ) {
+         const auto digest_itr = _last_prop_fin_digest.begin();
+         if( digest_itr != _last_prop_fin_digest.end() ) {
+            _last_prop_fin_digest_cached = *digest_itr;
          } else {
-            _last_prop_finalizers_cached = finalizers_itr->last_proposed_finalizers;
+            _last_prop_fin_digest_cached = last_prop_fin_digest_info{};
+
+            const auto finalizers_itr = _last_prop_finalizers.begin();
+            if( finalizers_itr != _last_prop_finalizers.end() ) {
+               auto& cached = *_last_prop_fin_digest_cached;
+               cached.digest = get_finalizers_digest(finalizers_itr->last_proposed_finalizers);
+               for( const auto& f: finalizers_itr->last_proposed_finalizers ) {
+                  cached.key_ids.push_back(f.key_id);
+               }
+            }
+         }
+      }
+
+      return *_last_prop_fin_digest_cached;
+   }
+
+   // Moves the full policy stored by previous versions to the digest table, once.
+   // Note: this function may never fail, as it is called by update_elected_producers.
+   void system_contract::migrate_last_proposed_finalizers() {
+      const auto finalizers_itr = _last_prop_finalizers.begin();
+      if( finalizers_itr == _last_prop_finalizers.end() ) {
+         return;
+      }
+
+      if( _last_prop_fin_digest.begin() == _last_prop_fin_digest.end() ) {
+         const auto& last_proposed = get_last_proposed_digest();
+         _last_prop_fin_digest.emplace( get_self(), [&]( auto& f ) {
+            f = last_proposed;
+         });
+      }
+      _last_prop_finalizers.erase(finalizers_itr);
+   }
+
+   // Rebuilds the last proposed finalizers from their key ids.
+   // A finalizer may have deleted its last key since the policy was proposed, the public key of
+   // such an entry is gone, so the policy can not be rebuilt and nothing is returned.
+   std::optional<std::vector<finalizer_auth_info>> system_contract::get_last_proposed_finalizers() {
+      const auto& key_ids = get_last_proposed_digest().key_ids;
+
+      std::vector<finalizer_auth_info> finalizers;
+      finalizers.reserve(key_ids.size());
+      for( const auto id: key_ids ) {
+         const auto key = _finalizer_keys.find(id);
+         if( key == _finalizer_keys.end() ) {
+            return std::nullopt;
          }
+         auto& f = finalizers.emplace_back();
+         f.key_id        = id;
+         f.fin_authority = eosio::finalizer_authority{
+            .description = key->finalizer_name.to_string(),
+            .weight      = 1,
+            .public_key  = key->finalizer_key_binary };
       }
 
-      return *_last_prop_finalizers_cached;
+      return finalizers;
    }
 
    // Generates an ID for a new finalizer key to be used in finalizer_keys table.
@@ -144,15 +208,16 @@ namespace eosiosystem {
 
       check(!is_savanna_consensus(), "switchtosvnn can be run only once");
 
+      const auto last_producer_schedule_size = get_gstate2().last_producer_schedule_size;
       std::vector< finalizer_auth_info > proposed_finalizers;
-      proposed_finalizers.reserve(_gstate.last_producer_schedule_size);
+      proposed_finalizers.reserve(last_producer_schedule_size);
 
       // Find a set of producers that meet all the normal requirements for
       // being a proposer and also have an active finalizer key.
       // The number of the producers must be equal to the number of producers
       // in the last_producer_schedule.
       auto idx = _producers.get_index<"prototalvote"_n>();
-      for( auto it = idx.cbegin(); it != idx.cend() && proposed_finalizers.size() < _gstate.last_producer_schedule_size && 0 < it->total_votes && it->active(); ++it ) {
+      for( auto it = idx.cbegin(); it != idx.cend() && proposed_finalizers.size() < last_producer_schedule_size && 0 < it->total_votes && it->active(); ++it ) {
          auto finalizer = _finalizers.find( it->owner.value );
          if( finalizer == _finalizers.end() ) {
             // The producer is not in finalizers table, indicating it does not have an
@@ -168,11 +233,14 @@ namespace eosiosystem {
          proposed_finalizers.emplace_back(*finalizer);
       }
 
-      check( proposed_finalizers.size() == _gstate.last_producer_schedule_size,
-            "not enough top producers have registered finalizer keys, has " + std::to_string(proposed_finalizers.size()) + ", require " + std::to_string(_gstate.last_producer_schedule_size) );
+      check( proposed_finalizers.size() == last_producer_schedule_size,
+            "not enough top producers have registered finalizer keys, has " + std::to_string(proposed_finalizers.size()) + ", require " + std::to_string(last_producer_schedule_size) );
 
       set_proposed_finalizers(std::move(proposed_finalizers));
       check( is_savanna_consensus(), "switching to Savanna failed" );
+
+      // Producers without an active finalizer key no longer qualify for the elected set
+      mark_elected_producers_dirty();
    }
 
    /*
@@ -204,6 +272,48 @@ namespace eosiosystem {
       // Proof of possession check
       check(eosio::bls_pop_verify(fin_key_g1, pop_g2), "proof of possession check failed");
 
+      add_finalizer_key( *producer, finalizer_key, fin_key_g1 );
+   }
+
+   void system_contract::regfinkeys( const name& finalizer_name, const std::vector<finalizer_key_pop>& finalizer_keys ) {
+      require_auth( finalizer_name );
+
+      check( !finalizer_keys.empty(), "require at least one finalizer key" );
+      check( finalizer_keys.size() <= max_batch_finalizer_keys, "number of finalizer keys exceeds the maximum allowed" );
+
+      auto producer = _producers.find( finalizer_name.value );
+      check( producer != _producers.end(), "finalizer " + finalizer_name.to_string() + " is not a registered producer");
+
+      std::vector<eosio::bls_g1> fin_keys_g1;
+      std::vector<eosio::bls_g2> pops_g2;
+      fin_keys_g1.reserve( finalizer_keys.size() );
+      pops_g2.reserve( finalizer_keys.size() );
+
+      const auto idx = _finalizer_keys.get_index<"byfinkey"_n>();
+      std::set<checksum256> hashes;
+      for( const auto& k : finalizer_keys ) {
+         check(k.proof_of_possession.compare(0, 7, "SIG_BLS") == 0, "proof of possession signature does not start with SIG_BLS: " + k.proof_of_possession);
+
+         fin_keys_g1.emplace_back( to_binary(k.finalizer_key) );
+         pops_g2.emplace_back( eosio::decode_bls_signature_to_g2(k.proof_of_possession) );
+
+         // Duplication check across all registered keys and within the batch
+         const auto hash = get_finalizer_key_hash(fin_keys_g1.back());
+         check(idx.find(hash) == idx.end() && hashes.insert(hash).second, "duplicate finalizer key: " + k.finalizer_key);
+      }
+
+      // All proofs of possession are checked by a single multi-pairing
+      check(bls_pop_verify_batch(fin_keys_g1, pops_g2), "proof of possession check failed");
+
+      for( size_t i = 0; i < finalizer_keys.size(); ++i ) {
+         add_finalizer_key( *producer, finalizer_keys[i].finalizer_key, fin_keys_g1[i] );
+      }
+   }
+
+   // Stores a verified finalizer key of a producer, the first key of a finalizer becomes its active key
+   void system_contract::add_finalizer_key( const producer_info& producer, const std::string& finalizer_key, const eosio::bls_g1& fin_key_g1 ) {
+      const auto& finalizer_name = producer.owner;
+
       // Insert the finalizer key into finalyzer_keys table
       const auto finalizer_key_itr = _finalizer_keys.emplace( finalizer_name, [&]( auto& k ) {
          k.id                   = get_next_finalizer_key_id();
@@ -223,6 +333,11 @@ namespace eosiosystem {
             f.active_key_binary    = finalizer_key_itr->finalizer_key_binary;
             f.finalizer_key_count  = 1;
          });
+
+         // The producer may now qualify for the elected set
+         if( is_savanna_consensus() ) {
+            check_elected_producers( producer, false );
+         }
       } else {
          // Update finalizer_key_count
          _finalizers.modify( finalizer, same_payer, [&]( auto& f ) {
@@ -262,28 +377,32 @@ namespace eosiosystem {
          f.active_key_binary  = finalizer_key_itr->finalizer_key_binary;
       });
 
-      const auto& last_proposed_finalizers = get_last_proposed_finalizers();
-      if( last_proposed_finalizers.empty() ) {
+      const auto& last_key_ids = get_last_proposed_digest().key_ids;
+      if( last_key_ids.empty() ) {
          // prior to switching to Savanna
          return;
       }
 
-      // Search last_proposed_finalizers for active_key_id
-      auto itr = std::lower_bound(last_proposed_finalizers.begin(), last_proposed_finalizers.end(), active_key_id, [](const finalizer_auth_info& key, uint64_t id) {
-         return key.key_id < id;
-      });
-
-      // If active_key_id is in last_proposed_finalizers, it means the finalizer is
-      // active. Replace the existing entry in last_proposed_finalizers with
+      // If active_key_id is in last proposed finalizers, it means the finalizer is
+      // active. Replace the existing entry in last proposed finalizers with
       // the information of finalizer_key just activated and call set_proposed_finalizers immediately
-      if( itr != last_proposed_finalizers.end() && itr->key_id == active_key_id ) {
-         auto proposed_finalizers = last_proposed_finalizers;
-         auto& matching_entry = proposed_finalizers[itr - last_proposed_finalizers.begin()];
+      if( std::binary_search(last_key_ids.begin(), last_key_ids.end(), active_key_id) ) {
+         auto proposed_finalizers = get_last_proposed_finalizers();
+         if( !proposed_finalizers.has_value() ) {
+            // A key of the last proposed policy was deleted, leaving it out would shrink the policy.
+            // The finalizers are proposed again from the elected producers at the next schedule update.
+            mark_elected_producers_dirty();
+            return;
+         }
+
+         auto& matching_entry = *std::find_if(proposed_finalizers->begin(), proposed_finalizers->end(), [&](const finalizer_auth_info& f) {
+            return f.key_id == active_key_id;
+         });
 
          matching_entry.key_id = finalizer_key_itr->id;
          matching_entry.fin_authority.public_key = finalizer_key_itr->finalizer_key_binary;
 
-         set_proposed_finalizers(std::move(proposed_finalizers));
+         set_proposed_finalizers(std::move(*proposed_finalizers));
       }
    }
 
@@ -316,6 +435,14 @@ namespace eosiosystem {
       if( finalizer->finalizer_key_count == 1 ) {
          // The finalizer does not have any registered keys. Remove it from finalizers table.
          _finalizers.erase( finalizer );
+
+         // An elected producer without finalizer key must be replaced in the elected set
+         if( is_savanna_consensus() ) {
+            auto producer = _producers.find( finalizer_name.value );
+            if( producer != _producers.end() ) {
+               check_elected_producers( *producer, true );
+            }
+         }
       } else {
          // Decrement finalizer_key_count finalizers table
          _finalizers.modify( finalizer, same_payer, [&]( auto& f ) {
@@ -30,11 +30,14 @@ namespace eosiosystem {
     _finalizer_keys(get_self(), get_self().value),
     _finalizers(get_self(), get_self().value),
     _last_prop_finalizers(get_self(), get_self().value),
+    _last_prop_fin_digest(get_self(), get_self().value),
     _fin_key_id_generator(get_self(), get_self().value),
+    _elected_producers(get_self(), get_self().value),
+    _production_round(get_self(), get_self().value),
    #endif//ENABLE_VOTING_PRODUCER
-    _global(get_self(), get_self().value)
+    _global(get_self(), get_self().value),
+    _global2(get_self(), get_self().value)
    {
-      _gstate  = _global.exists() ? _global.get() : get_default_parameters();
    }
 
    eosio_global_state system_contract::get_default_parameters() {
@@ -43,13 +46,76 @@ namespace eosiosystem {
       return dp;
    }
 
+   // Returns the blockchain parameters part of global state, loaded on first use
+   const eosio_global_state& system_contract::get_gstate() {
+      if( !_gstate.has_value() ) {
+         _gstate = _global.exists() ? _global.get() : get_default_parameters();
+      }
+      return *_gstate;
+   }
+
+   // Returns the blockchain parameters part of global state for update, it is saved on destruction
+   eosio_global_state& system_contract::mutable_gstate() {
+      get_gstate();
+      _gstate_dirty = true;
+      return *_gstate;
+   }
+
+   // Returns the frequently updated part of global state, loaded on first use
+   const eosio_global_state2& system_contract::get_gstate2() {
+      if( !_gstate2.has_value() ) {
+         if( _global2.exists() ) {
+            _gstate2 = _global2.get();
+         } else {
+            // Migrate the election and reward fields from the `global` singleton, then zero them there
+            _gstate2.emplace();
+            if( _global.exists() ) {
+               auto& gstate = mutable_gstate();
+               _gstate2->total_vote_stake               = gstate.total_vote_stake;
+               _gstate2->election_activated_time        = gstate.election_activated_time;
+               _gstate2->reward_started_time            = gstate.reward_started_time;
+               _gstate2->initial_rewards_per_block      = gstate.initial_rewards_per_block;
+               _gstate2->total_produced_rewards         = gstate.total_produced_rewards;
+               _gstate2->total_unclaimed_rewards        = gstate.total_unclaimed_rewards;
+               _gstate2->last_producer_schedule_size    = gstate.last_producer_schedule_size;
+               _gstate2->last_producer_schedule_update  = gstate.last_producer_schedule_update;
+               _gstate2->last_name_close                = gstate.last_name_close;
+               _gstate2_dirty = true;
+
+               gstate.total_vote_stake.amount           = 0;
+               gstate.election_activated_time           = time_point();
+               gstate.reward_started_time               = time_point();
+               gstate.initial_rewards_per_block.amount  = 0;
+               gstate.total_produced_rewards.amount     = 0;
+               gstate.total_unclaimed_rewards.amount    = 0;
+               gstate.last_producer_schedule_size       = 0;
+               gstate.last_producer_schedule_update     = block_timestamp();
+               gstate.last_name_close                   = block_timestamp();
+            }
+         }
+      }
+      return *_gstate2;
+   }
+
+   // Returns the frequently updated part of global state for update, it is saved on destruction
+   eosio_global_state2& system_contract::mutable_gstate2() {
+      get_gstate2();
+      _gstate2_dirty = true;
+      return *_gstate2;
+   }
+
    // symbol system_contract::core_symbol()const {
    //    const static auto sym = get_core_symbol();
    //    return sym;
    // }
 
    system_contract::~system_contract() {
-      _global.set( _gstate, get_self() );
+      if( _gstate_dirty ) {
+         _global.set( *_gstate, get_self() );
+      }
+      if( _gstate2_dirty ) {
+         _global2.set( *_gstate2, get_self() );
+      }
    }
 
    void system_contract::channel_to_system_fees( const name& from, const asset& amount ) {
@@ -96,8 +162,9 @@ namespace eosiosystem {
 
    void system_contract::setparams( const blockchain_parameters_t& params ) {
       require_auth( get_self() );
-      (eosio::blockchain_parameters&)(_gstate) = params;
-      check( 3 <= _gstate.max_authority_depth, "max_authority_depth should be at least 3" );
+      auto& gstate = mutable_gstate();
+      (eosio::blockchain_parameters&)(gstate) = params;
+      check( 3 <= gstate.max_authority_depth, "max_authority_depth should be at least 3" );
 #ifndef SYSTEM_BLOCKCHAIN_PARAMETERS
       set_blockchain_parameters( params );
 #else
@@ -222,6 +289,18 @@ namespace eosiosystem {
 
    void system_contract::setalimits( const name& account, uint64_t gas, bool is_unlimited ) {
       require_auth( get_self() );
+      set_account_limits( account, gas, is_unlimited );
+   }
+
+   void system_contract::batchalimits( const std::vector<account_limits>& limits ) {
+      require_auth( get_self() );
+      check( !limits.empty(), "limits cannot be empty" );
+      for( const auto& l : limits ) {
+         set_account_limits( l.account, l.gas, l.is_unlimited );
+      }
+   }
+
+   void system_contract::set_account_limits( const name& account, uint64_t gas, bool is_unlimited ) {
       check( is_account(account), "account not exists" );
 
       // TODO: validate gas range?
@@ -250,6 +329,7 @@ namespace eosiosystem {
       _producers.modify( prod, same_payer, [&](auto& p) {
             p.deactivate();
          });
+      check_elected_producers( *prod, true );
    }
    #endif//ENABLE_VOTING_PRODUCER
 
@@ -328,12 +408,15 @@ namespace eosiosystem {
       require_auth( get_self() );
       check( version.value == 0, "unsupported version for init action" );
 
-      check( !_gstate.total_vote_stake.symbol.is_valid(), "system contract has already been initialized" );
+      check( !is_init(), "system contract has already been initialized" );
 
-      _gstate.total_vote_stake.symbol = core;
-      _gstate.initial_rewards_per_block.symbol = core;
-      _gstate.total_produced_rewards.symbol = core;
-      _gstate.total_unclaimed_rewards.symbol = core;
+      auto& gstate2 = mutable_gstate2();
+      gstate2.total_vote_stake.symbol = core;
+      gstate2.initial_rewards_per_block.symbol = core;
+      gstate2.total_produced_rewards.symbol = core;
+      gstate2.total_unclaimed_rewards.symbol = core;
+      // store the current blockchain parameters in `global`
+      mutable_gstate();
 
       auto system_token_supply   = eosio::token::get_supply(token_account, core.code() );
       check( system_token_supply.symbol == core, "specified core symbol does not exist (precision mismatch)" );
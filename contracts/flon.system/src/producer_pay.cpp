@@ -35,7 +35,8 @@ namespace eosiosystem {
 
       #ifdef ENABLE_VOTING_PRODUCER
       /** check producer reward started */
-      if( _gstate.election_activated_time == time_point() || timestamp < _gstate.election_activated_time )
+      const auto& gstate2 = get_gstate2();
+      if( gstate2.election_activated_time == time_point() || timestamp < gstate2.election_activated_time )
          return;
 
 
@@ -46,23 +47,17 @@ namespace eosiosystem {
        * At startup the initial producer may not be one that is registered / elected
        * and therefore there may be no producer object for them.
        */
-      auto prod = _producers.find( producer.value );
-      if ( prod != _producers.end() && _gstate.reward_started_time != time_point() && now >= _gstate.reward_started_time ) {
-         // cur_period start at 0
-         int64_t cur_period = (now - _gstate.reward_started_time).to_seconds() / reward_halving_period_seconds;
-         auto rewards_per_block = _gstate.initial_rewards_per_block.amount / power(2, cur_period);
-         _producers.modify( prod, same_payer, [&](auto& p ) {
-            p.unclaimed_rewards.amount += rewards_per_block;
-         });
-         _gstate.total_produced_rewards.amount += rewards_per_block;
-         _gstate.total_unclaimed_rewards.amount += rewards_per_block;
+      if ( gstate2.reward_started_time != time_point() && now >= gstate2.reward_started_time &&
+           _producers.find( producer.value ) != _producers.end() ) {
+         count_produced_block( producer, now );
       }
 
       /// only update block producers once every minute, block_timestamp is in half seconds
-      if( timestamp.slot - _gstate.last_producer_schedule_update.slot > 120 ) {
+      if( timestamp.slot - gstate2.last_producer_schedule_update.slot > 120 ) {
+         settle_produced_blocks();
          update_elected_producers( timestamp );
 
-         if( (timestamp.slot - _gstate.last_name_close.slot) > blocks_per_day ) {
+         if( (timestamp.slot - gstate2.last_name_close.slot) > blocks_per_day ) {
             name_bid_table bids(get_self(), get_self().value);
             auto idx = bids.get_index<"highbid"_n>();
             auto highest = idx.lower_bound( std::numeric_limits<uint64_t>::max()/2 );
@@ -70,7 +65,7 @@ namespace eosiosystem {
                 highest->high_bid > 0 &&
                 (current_time_point() - highest->last_bid_time) > microseconds(useconds_per_day)
             ) {
-               _gstate.last_name_close = timestamp;
+               mutable_gstate2().last_name_close = timestamp;
                channel_to_system_fees( names_account, asset( highest->high_bid, core_symbol() ) );
 
                // logging
@@ -87,6 +82,96 @@ namespace eosiosystem {
    }
 
    #ifdef ENABLE_VOTING_PRODUCER
+   // Returns the production counters of the current schedule round
+   const production_round_info& system_contract::get_production_round() {
+      if( !_production_round_cached.has_value() ) {
+         const auto itr = _production_round.begin();
+         if( itr == _production_round.end() ) {
+            _production_round_cached.emplace();
+         } else {
+            _production_round_cached = *itr;
+         }
+      }
+
+      return *_production_round_cached;
+   }
+
+   // Stores the production counters in both cache and DB table
+   void system_contract::save_production_round( production_round_info info ) {
+      auto itr = _production_round.begin();
+      if( itr == _production_round.end() ) {
+         _production_round.emplace( get_self(), [&]( auto& r ) {
+            r = info;
+         });
+      } else {
+         _production_round.modify( itr, same_payer, [&]( auto& r ) {
+            r = info;
+         });
+      }
+      _production_round_cached = std::move(info);
+   }
+
+   // Counts a block produced by `producer` at `now`, rewards are settled at the next schedule update
+   void system_contract::count_produced_block( const name& producer, const time_point& now ) {
+      const auto& gstate2 = get_gstate2();
+      // cur_period start at 0
+      int64_t cur_period = (now - gstate2.reward_started_time).to_seconds() / reward_halving_period_seconds;
+
+      if( get_production_round().reward_period != cur_period ) {
+         // the blocks counted so far are rewarded at the rate of the previous period
+         settle_produced_blocks();
+      }
+
+      auto round = get_production_round();
+      if( round.reward_period != cur_period ) {
+         round.reward_period     = cur_period;
+         round.rewards_per_block = cur_period < 63 ? gstate2.initial_rewards_per_block.amount / power(2, cur_period) : 0;
+      }
+
+      auto itr = std::find_if( round.produced_blocks.begin(), round.produced_blocks.end(), [&]( const auto& b ) {
+         return b.producer == producer;
+      });
+      if( itr == round.produced_blocks.end() ) {
+         round.produced_blocks.push_back( produced_blocks_info{ producer, 1 } );
+      } else {
+         ++itr->blocks;
+      }
+      save_production_round( std::move(round) );
+   }
+
+   // Moves the rewards of the counted blocks to the unclaimed rewards of their producers.
+   // `reset_rewards_per_block` drops the cached block reward, which must be recomputed
+   // after the initial rewards per block changed.
+   void system_contract::settle_produced_blocks( bool reset_rewards_per_block ) {
+      const auto& round = get_production_round();
+      if( round.produced_blocks.empty() && ( !reset_rewards_per_block || round.reward_period == -1 ) ) {
+         return;
+      }
+
+      int64_t settled_rewards = 0;
+      for( const auto& b : round.produced_blocks ) {
+         const int64_t rewards = round.rewards_per_block * b.blocks;
+         if( rewards == 0 ) continue;
+
+         const auto& prod = _producers.get( b.producer.value, "producer not found" );
+         _producers.modify( prod, same_payer, [&](auto& p ) {
+            p.unclaimed_rewards.amount += rewards;
+         });
+         settled_rewards += rewards;
+      }
+
+      if( settled_rewards > 0 ) {
+         auto& gstate2 = mutable_gstate2();
+         gstate2.total_produced_rewards.amount += settled_rewards;
+         gstate2.total_unclaimed_rewards.amount += settled_rewards;
+      }
+
+      production_round_info settled;
+      settled.reward_period     = reset_rewards_per_block ? -1 : round.reward_period;
+      settled.rewards_per_block = reset_rewards_per_block ? 0 : round.rewards_per_block;
+      save_production_round( std::move(settled) );
+   }
+
    void system_contract::claimrewards( const name& owner ) {
       require_auth( owner );
       check(false, "unsupport claimrewards currently");
@@ -101,25 +186,28 @@ namespace eosiosystem {
       check(initial_rewards_per_block.amount >= 0, "reward can not be negative");
 
       const auto& now = eosio::current_time_point();
-      if (_gstate.election_activated_time == time_point() || _gstate.election_activated_time > now ) {
+      auto& gstate2 = mutable_gstate2();
+      if (gstate2.election_activated_time == time_point() || gstate2.election_activated_time > now ) {
          check(election_activated_time > now, "election activated time must larger than now");
-         _gstate.election_activated_time = election_activated_time;
+         gstate2.election_activated_time = election_activated_time;
       } else {
-         check( election_activated_time == _gstate.election_activated_time,
+         check( election_activated_time == gstate2.election_activated_time,
             "can not change election activated time after election has already been activated");
       }
 
-      check(reward_started_time >= _gstate.election_activated_time, "reward start time can not less than election activated time");
+      check(reward_started_time >= gstate2.election_activated_time, "reward start time can not less than election activated time");
 
-      if (_gstate.reward_started_time == time_point() || _gstate.reward_started_time > now ) {
+      if (gstate2.reward_started_time == time_point() || gstate2.reward_started_time > now ) {
          check(reward_started_time > now, "reward start time must larger than now");
-         _gstate.reward_started_time = reward_started_time;
+         gstate2.reward_started_time = reward_started_time;
       } else {
-         check( reward_started_time == _gstate.reward_started_time,
+         check( reward_started_time == gstate2.reward_started_time,
             "can not change reward start timee after reward has already been started");
       }
 
-      _gstate.initial_rewards_per_block = initial_rewards_per_block;
+      // blocks counted so far are rewarded at the previous rate
+      settle_produced_blocks( true );
+      gstate2.initial_rewards_per_block = initial_rewards_per_block;
    }
    #endif//ENABLE_VOTING_PRODUCER
 } //namespace eosiosystem
\ No newline at end of file
@@ -8,11 +8,13 @@
 #include <eosio/singleton.hpp>
 
 #include <flon.system/flon.system.hpp>
+#include <flon.system/schedule_order.hpp>
 #include <flon.token/flon.token.hpp>
 #include <flon.reward/flon.reward.hpp>
 
 #include <type_traits>
 #include <limits>
+#include <map>
 #include <set>
 #include <algorithm>
 #include <cmath>
@@ -69,6 +71,8 @@ namespace eosiosystem {
             if (reward_shared_ratio)
                info.reward_shared_ratio = *reward_shared_ratio;
          });
+         // a changed authority of an elected producer requires a new schedule
+         check_elected_producers( *prod, true );
 
       } else {
          _producers.emplace( producer, [&]( producer_info& info ){
@@ -119,10 +123,107 @@ namespace eosiosystem {
       _producers.modify( prod, same_payer, [&]( producer_info& info ){
          info.deactivate();
       });
+      check_elected_producers( prod, true );
+   }
+
+   // Returns the elected producer set of the last schedule update
+   const elected_producers_info& system_contract::get_elected_producers() {
+      if( !_elected_producers_cached.has_value() ) {
+         const auto itr = _elected_producers.begin();
+         if( itr == _elected_producers.end() ) {
+            // Never computed before, start dirty so that the next schedule update walks the vote index
+            _elected_producers_cached.emplace();
+            _elected_producers_cached->vote_generation = 1;
+         } else {
+            _elected_producers_cached = *itr;
+         }
+      }
+
+      return *_elected_producers_cached;
+   }
+
+   // Stores the elected producer set in both cache and DB table
+   void system_contract::save_elected_producers( elected_producers_info info ) {
+      auto itr = _elected_producers.begin();
+      if( itr == _elected_producers.end() ) {
+         _elected_producers.emplace( get_self(), [&]( auto& e ) {
+            e = info;
+         });
+      } else {
+         _elected_producers.modify( itr, same_payer, [&]( auto& e ) {
+            e = info;
+         });
+      }
+      _elected_producers_cached = std::move(info);
+   }
+
+   // Bumps the vote generation so that the next schedule update recomputes the elected set.
+   // Only the first change after a schedule update writes the table.
+   void system_contract::mark_elected_producers_dirty() {
+      const auto& elected = get_elected_producers();
+      if( elected.is_dirty() ) {
+         return;
+      }
+
+      auto info = elected;
+      ++info.vote_generation;
+      save_elected_producers( std::move(info) );
+   }
+
+   // Marks the elected set dirty if the change of `prod` may alter its membership:
+   // an elected producer that may leave the set (`may_leave`: lost votes, deactivated or changed authority),
+   // or a candidate outside the set that reached the lowest elected votes.
+   void system_contract::check_elected_producers( const producer_info& prod, bool may_leave ) {
+      const auto& elected = get_elected_producers();
+      if( elected.is_dirty() ) {
+         return;
+      }
+
+      if( elected.is_elected( prod.owner ) ) {
+         if( may_leave ) {
+            mark_elected_producers_dirty();
+         }
+      } else if( prod.active() && prod.total_votes > 0 &&
+                 ( elected.elected_producers.size() < 21 || prod.total_votes >= elected.min_elected_votes ) ) {
+         mark_elected_producers_dirty();
+      }
+   }
+
+   std::vector<std::vector<uint32_t>> system_contract::get_location_latencies( const std::vector<uint16_t>& locations ) {
+      const uint32_t n = locations.size();
+      std::vector<std::vector<uint32_t>> latencies( n, std::vector<uint32_t>( n, 0 ) );
+
+      location_latency_table latency_tbl( get_self(), get_self().value );
+      std::map<uint64_t, uint32_t> latency_cache;
+      for( uint32_t i = 0; i < n; ++i ) {
+         for( uint32_t j = i + 1; j < n; ++j ) {
+            if( locations[i] == locations[j] ) {
+               continue;
+            }
+            const auto location_a = std::min( locations[i], locations[j] );
+            const auto location_b = std::max( locations[i], locations[j] );
+            const uint64_t key = uint64_t(location_a) << 16 | location_b;
+            auto cached = latency_cache.find( key );
+            if( cached == latency_cache.end() ) {
+               const auto itr = latency_tbl.find( key );
+               cached = latency_cache.emplace( key, itr == latency_tbl.end() ? default_location_latency_ms : itr->latency_ms ).first;
+            }
+            latencies[i][j] = latencies[j][i] = cached->second;
+         }
+      }
+      return latencies;
    }
 
    void system_contract::update_elected_producers( const block_timestamp& block_time ) {
-      _gstate.last_producer_schedule_update = block_time;
+      mutable_gstate2().last_producer_schedule_update = block_time;
+      migrate_last_proposed_finalizers();
+
+      // No vote or producer change could have altered the elected set since last time
+      const auto& elected = get_elected_producers();
+      if( !elected.is_dirty() ) {
+         return;
+      }
+      const auto vote_generation = elected.vote_generation;
 
       auto idx = _producers.get_index<"prototalvote"_n>();
 
@@ -133,6 +234,7 @@ namespace eosiosystem {
       proposed_finalizers.reserve(21);
 
       bool is_savanna = is_savanna_consensus();
+      int64_t min_elected_votes = 0;
 
       for( auto it = idx.cbegin(); it != idx.cend() && top_producers.size() < 21 && 0 < it->total_votes && it->active(); ++it ) {
          if( is_savanna ) {
@@ -158,25 +260,41 @@ namespace eosiosystem {
             },
             it->location
          );
+         min_elected_votes = it->total_votes; // the index is in descending order of votes
       }
 
-      if( top_producers.size() == 0 || top_producers.size() < _gstate.last_producer_schedule_size ) {
+      // Keep the elected set dirty so that it is retried on the next schedule update
+      if( top_producers.size() == 0 || top_producers.size() < get_gstate2().last_producer_schedule_size ) {
          return;
       }
 
       std::sort( top_producers.begin(), top_producers.end(), []( const value_type& lhs, const value_type& rhs ) {
          return lhs.first.producer_name < rhs.first.producer_name; // sort by producer name
-         // return lhs.second < rhs.second; // sort by location
       } );
 
       std::vector<eosio::producer_authority> producers;
+      elected_producers_info new_elected;
+      new_elected.vote_generation    = vote_generation;
+      new_elected.elected_generation = vote_generation;
+      new_elected.min_elected_votes  = min_elected_votes;
+      new_elected.elected_producers.reserve(top_producers.size());
+
+      std::vector<uint16_t> locations;
+      locations.reserve(top_producers.size());
+      for( const auto& item : top_producers ) {
+         new_elected.elected_producers.push_back( item.first.producer_name );
+         locations.push_back( item.second );
+      }
 
+      // the schedule starts with the first producer by name and keeps consecutive producers close to each other
       producers.reserve(top_producers.size());
-      for( auto& item : top_producers )
-         producers.push_back( std::move(item.first) );
+      for( auto i : order_by_latency( get_location_latencies( locations ) ) ) {
+         producers.push_back( std::move(top_producers[i].first) );
+      }
 
       if( set_proposed_producers( producers ) >= 0 ) {
-         _gstate.last_producer_schedule_size = static_cast<decltype(_gstate.last_producer_schedule_size)>( producers.size() );
+         auto& gstate2 = mutable_gstate2();
+         gstate2.last_producer_schedule_size = static_cast<decltype(gstate2.last_producer_schedule_size)>( producers.size() );
       }
 
       // set_proposed_finalizers() checks if last proposed finalizer policy
@@ -184,6 +302,8 @@ namespace eosiosystem {
       if( is_savanna ) {
          set_proposed_finalizers( std::move(proposed_finalizers) );
       }
+
+      save_elected_producers( std::move(new_elected) );
    }
 
    // double stake2vote( int64_t staked ) {
@@ -215,19 +335,17 @@ namespace eosiosystem {
       auto old_prod_itr = old_prods.begin();
       auto new_prod_itr = producers.begin();
       std::vector<name> removed_prods; removed_prods.reserve(old_prods.size());
-      std::vector<name> modified_prods; removed_prods.reserve(old_prods.size());
       std::vector<name> added_prods;   added_prods.reserve(producers.size());
       while(old_prod_itr != old_prods.end() || new_prod_itr != producers.end()) {
 
          if (old_prod_itr != old_prods.end() && new_prod_itr != producers.end()) {
-            if (old_prod_itr < new_prod_itr) {
+            if (*old_prod_itr < *new_prod_itr) {
                removed_prods.push_back(*old_prod_itr);
                old_prod_itr++;
-            } else if (new_prod_itr < old_prod_itr) {
+            } else if (*new_prod_itr < *old_prod_itr) {
                added_prods.push_back(*new_prod_itr);
                new_prod_itr++;
-            } else { // new_prod_itr == old_prod_itr
-               modified_prods.push_back(*old_prod_itr);
+            } else { // *new_prod_itr == *old_prod_itr, votes of the kept producer are unchanged
                old_prod_itr++;
                new_prod_itr++;
             }
@@ -241,11 +359,10 @@ namespace eosiosystem {
       }
 
       update_producer_votes(removed_prods, -voter_itr->votes, false);
-      update_producer_votes(modified_prods, 0, false);
       update_producer_votes(added_prods, voter_itr->votes, false);
 
-      flon::flon_reward::voteproducer_action voteproducer_act{ reward_account, { {get_self(), active_permission}, {voter_name, active_permission} } };
-      voteproducer_act.send( voter_name, producers );
+      // flon.reward updates its accounting from the notification, after the voter and producer rows are written
+      require_recipient( reward_account );
 
       _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
          v.producers          = producers;
@@ -263,6 +380,8 @@ namespace eosiosystem {
 
          if (votes_delta > 0) {
             CHECK( pitr->active() , "producer " + pitr->owner.to_string() + " is not active" );
+         } else if (votes_delta == 0) {
+            continue;
          }
          // CHECK(pitr->ext, "producer " + pitr->owner.to_string() + " is not updated by regproducer")
 
@@ -272,6 +391,7 @@ namespace eosiosystem {
             // _elect_gstate.total_producer_elected_votes += votes_delta;
             // CHECK(_elect_gstate.total_producer_elected_votes >= 0, "total_producer_elected_votes can not be negative");
          });
+         check_elected_producers( *pitr, votes_delta < 0 );
       }
    }
 
@@ -281,16 +401,19 @@ namespace eosiosystem {
       CHECK(vote_staked.symbol == core_symbol(), "vote_staked must be core symbol")
       CHECK(vote_staked.amount > 0, "vote_staked must be positive")
 
-      if (_gstate.total_vote_stake.amount == 0) {
-         _gstate.total_vote_stake = vote_staked;
+      auto& gstate2 = mutable_gstate2();
+      if (gstate2.total_vote_stake.amount == 0) {
+         gstate2.total_vote_stake = vote_staked;
       } else {
-         _gstate.total_vote_stake += vote_staked;
+         gstate2.total_vote_stake += vote_staked;
       }
 
       auto votes = vote_staked.amount;
       eosio::token::transfer_action transfer_act{ token_account, { {voter, active_permission} } };
       transfer_act.send( voter, vote_account, vote_staked, "addvote" );
 
+      settle_vote_refunds( voter );
+
       auto now = current_time_point();
       auto voter_itr = _voters.find( voter.value );
       if( voter_itr != _voters.end() ) {
@@ -300,22 +423,24 @@ namespace eosiosystem {
 
          _voters.modify( voter_itr, same_payer, [&]( auto& v ) {
             v.votes             += votes;
+            CHECKC( v.votes >= min_voter_votes, err::VOTE_ERROR, "voter votes can not be less than min_voter_votes" )
          });
       } else {
+         CHECKC( votes >= min_voter_votes, err::VOTE_ERROR, "voter votes can not be less than min_voter_votes" )
          _voters.emplace( voter, [&]( auto& v ) {
             v.owner              = voter;
             v.votes              = votes;
          });
       }
 
-      flon::flon_reward::addvote_action addvote_act{ reward_account, { {get_self(), active_permission}, {voter, active_permission} } };
-      addvote_act.send( voter, votes );
+      require_recipient( reward_account );
    }
 
    void system_contract::subvote( const name& voter, const asset& vote_staked ) {
       require_auth(voter);
       auto now = current_time_point();
-      CHECK( _gstate.election_activated_time != time_point() && _gstate.election_activated_time <= now,
+      auto& gstate2 = mutable_gstate2();
+      CHECK( gstate2.election_activated_time != time_point() && gstate2.election_activated_time <= now,
              "cannot subvote until the election is activated" );
 
       CHECK(vote_staked.symbol == core_symbol(), "vote_staked must be core symbol")
@@ -326,14 +451,23 @@ namespace eosiosystem {
       CHECK( voter_itr != _voters.end(), "voter not found" )
 
       CHECK( voter_itr->votes >= votes, "votes insufficent" )
+      CHECKC( voter_itr->votes == votes || voter_itr->votes - votes >= min_voter_votes, err::VOTE_ERROR,
+              "voter votes can not be less than min_voter_votes" )
 
-      CHECK(_gstate.total_vote_stake >= vote_staked, "Total vote stake insufficent")
-      _gstate.total_vote_stake -= vote_staked;
+      CHECK(gstate2.total_vote_stake >= vote_staked, "Total vote stake insufficent")
+      gstate2.total_vote_stake -= vote_staked;
 
       // CHECKC( time_point(voter_itr->last_unvoted_time) + seconds(vote_interval_sec) < now, err::VOTE_ERROR, "Voter can only vote or subvote once a day" )
 
-      vote_refund_table vote_refund_tbl( get_self(), voter.value );
-      CHECKC( vote_refund_tbl.find( voter.value ) == vote_refund_tbl.end(), err::VOTE_REFUND_ERROR, "This account already has a vote refund" );
+      settle_vote_refunds( voter );
+
+      vote_refund_queue refund_queue( get_self(), get_self().value );
+      auto owner_idx = refund_queue.get_index<"byowner"_n>();
+      uint32_t pending_tranches = 0;
+      for( auto itr = owner_idx.lower_bound( voter.value ); itr != owner_idx.end() && itr->owner == voter; ++itr ) {
+         ++pending_tranches;
+      }
+      CHECKC( pending_tranches < max_vote_refund_tranches, err::VOTE_REFUND_ERROR, "too many pending vote refunds" );
 
       update_producer_votes(voter_itr->producers, -votes, false);
 
@@ -342,33 +476,154 @@ namespace eosiosystem {
          v.last_unvoted_time  = now;
       });
 
-      flon::flon_reward::subvote_action subvote_act{ reward_account, { {get_self(), active_permission}, {voter, active_permission} } };
-      subvote_act.send( voter, votes );
+      require_recipient( reward_account );
 
-      vote_refund_tbl.emplace( voter, [&]( auto& r ) {
-         r.owner = voter;
-         r.vote_staked = vote_staked;
+      refund_queue.emplace( voter, [&]( auto& r ) {
+         r.id           = refund_queue.available_primary_key();
+         r.owner        = voter;
+         r.vote_staked  = vote_staked;
          r.request_time = now;
       });
+   }
+
+   // Pays out the matured refunds of `owner` in one transfer, including a refund queued before the refund queue existed
+   asset system_contract::settle_vote_refunds( const name& owner ) {
+      const auto now = current_time_point();
+      asset refunded( 0, core_symbol() );
+
+      vote_refund_table vote_refund_tbl( get_self(), owner.value );
+      auto legacy_itr = vote_refund_tbl.find( owner.value );
+      if( legacy_itr != vote_refund_tbl.end() && legacy_itr->request_time + seconds(refund_delay_sec) <= now ) {
+         refunded += legacy_itr->vote_staked;
+         vote_refund_tbl.erase( legacy_itr );
+      }
 
-      static const name act_name = "voterefund"_n;
-      uint128_t trx_send_id = uint128_t(act_name.value) << 64 | voter.value;
-      eosio::transaction refund_trx;
-      auto pl = permission_level{ voter, active_permission };
-      refund_trx.actions.emplace_back( pl, _self, act_name, voter );
-      refund_trx.delay_sec = refund_delay_sec;
-      refund_trx.send( trx_send_id, voter, true );
+      vote_refund_queue refund_queue( get_self(), get_self().value );
+      auto owner_idx = refund_queue.get_index<"byowner"_n>();
+      auto itr = owner_idx.lower_bound( owner.value );
+      while( itr != owner_idx.end() && itr->owner == owner && itr->request_time + seconds(refund_delay_sec) <= now ) {
+         refunded += itr->vote_staked;
+         itr = owner_idx.erase( itr );
+      }
+
+      if( refunded.amount > 0 ) {
+         eosio::token::transfer_action transfer_act{ token_account, { {vote_account, active_permission} } };
+         transfer_act.send( vote_account, owner, refunded, "voterefund" );
+      }
+      return refunded;
    }
 
    void system_contract::voterefund( const name& owner ) {
-      vote_refund_table vote_refund_tbl( get_self(), owner.value );
-      auto itr = vote_refund_tbl.find( owner.value );
-      check( itr != vote_refund_tbl.end(), "no vote refund found" );
-      check( itr->request_time + seconds(refund_delay_sec) <= current_time_point(), "refund period not mature yet" );
+      CHECKC( settle_vote_refunds( owner ).amount > 0, err::VOTE_REFUND_ERROR, "no matured vote refund found" );
+   }
+
+   void system_contract::setlatency( uint16_t location_a, uint16_t location_b, uint32_t latency_ms ) {
+      require_auth( get_self() );
+      CHECKC( location_a != location_b, err::PARAM_ERROR, "locations must be different" );
+      if( location_a > location_b ) {
+         std::swap( location_a, location_b );
+      }
+
+      location_latency_table latency_tbl( get_self(), get_self().value );
+      auto itr = latency_tbl.find( uint64_t(location_a) << 16 | location_b );
+      if( latency_ms == 0 ) {
+         CHECKC( itr != latency_tbl.end(), err::RECORD_NOT_FOUND, "latency not found" );
+         latency_tbl.erase( itr );
+      } else if( itr == latency_tbl.end() ) {
+         latency_tbl.emplace( get_self(), [&]( auto& l ) {
+            l.location_a = location_a;
+            l.location_b = location_b;
+            l.latency_ms = latency_ms;
+         });
+      } else {
+         latency_tbl.modify( itr, same_payer, [&]( auto& l ) {
+            l.latency_ms = latency_ms;
+         });
+      }
+      mark_elected_producers_dirty();
+   }
 
+   void system_contract::refundsweep( uint32_t max_count ) {
+      const auto now = current_time_point();
+      vote_refund_queue refund_queue( get_self(), get_self().value );
+      auto time_idx = refund_queue.get_index<"byreqtime"_n>();
       eosio::token::transfer_action transfer_act{ token_account, { {vote_account, active_permission} } };
-      transfer_act.send( vote_account, itr->owner, itr->vote_staked, "voterefund" );
-      vote_refund_tbl.erase( itr );
+
+      max_count = std::min( max_count, max_refund_sweep_count );
+      uint32_t count = 0;
+      name owner;
+      asset refunded( 0, core_symbol() );
+      auto itr = time_idx.begin();
+      for( ; count < max_count && itr != time_idx.end() && itr->request_time + seconds(refund_delay_sec) <= now; ++count ) {
+         // consecutive tranches of the same owner are paid out in one transfer
+         if( itr->owner != owner && refunded.amount > 0 ) {
+            transfer_act.send( vote_account, owner, refunded, "voterefund" );
+            refunded.amount = 0;
+         }
+         owner     = itr->owner;
+         refunded += itr->vote_staked;
+         itr = time_idx.erase( itr );
+      }
+      CHECKC( count > 0, err::VOTE_REFUND_ERROR, "no matured vote refund found" );
+      transfer_act.send( vote_account, owner, refunded, "voterefund" );
+   }
+
+   std::vector<producer_vote_info> system_contract::getproducers( uint32_t limit ) {
+      CHECKC( limit > 0, err::PARAM_ERROR, "limit must be positive" );
+      const auto& elected = get_elected_producers();
+
+      std::vector<producer_vote_info> producers;
+      auto idx = _producers.get_index<"prototalvote"_n>();
+      for( auto itr = idx.cbegin(); itr != idx.cend() && itr->active() && producers.size() < limit; ++itr ) {
+         auto& p = producers.emplace_back();
+         p.owner        = itr->owner;
+         p.total_votes  = itr->total_votes;
+         p.location     = itr->location;
+         p.is_elected   = elected.is_elected( itr->owner );
+         p.is_finalizer = _finalizers.find( itr->owner.value ) != _finalizers.end();
+      }
+      return producers;
+   }
+
+   voter_state system_contract::getvoter( const name& voter ) {
+      auto voter_itr = _voters.find( voter.value );
+      CHECKC( voter_itr != _voters.end(), err::RECORD_NOT_FOUND, "voter not found" );
+      const auto& v = *voter_itr;
+
+      voter_state state;
+      state.owner             = v.owner;
+      state.votes             = v.votes;
+      state.producers         = v.producers;
+      state.last_unvoted_time = v.last_unvoted_time;
+
+      flon::flon_reward::voter::table reward_voters( reward_account, reward_account.value );
+      auto reward_itr = reward_voters.find( voter.value );
+      if( reward_itr != reward_voters.end() ) {
+         state.unclaimed_rewards = flon::flon_reward::get_unclaimed_rewards( reward_account, *reward_itr );
+         state.claimed_rewards   = reward_itr->claimed_rewards;
+      } else {
+         state.unclaimed_rewards = asset( 0, core_symbol() );
+         state.claimed_rewards   = asset( 0, core_symbol() );
+      }
+
+      const auto now = current_time_point();
+      auto add_refund = [&]( const time_point_sec& request_time, const asset& vote_staked ) {
+         auto& r = state.refunds.emplace_back();
+         r.request_time = request_time;
+         r.vote_staked  = vote_staked;
+         r.is_matured   = request_time + seconds(refund_delay_sec) <= now;
+      };
+      vote_refund_table vote_refund_tbl( get_self(), voter.value );
+      auto legacy_itr = vote_refund_tbl.find( voter.value );
+      if( legacy_itr != vote_refund_tbl.end() ) {
+         add_refund( legacy_itr->request_time, legacy_itr->vote_staked );
+      }
+      vote_refund_queue refund_queue( get_self(), get_self().value );
+      auto owner_idx = refund_queue.get_index<"byowner"_n>();
+      for( auto itr = owner_idx.lower_bound( voter.value ); itr != owner_idx.end() && itr->owner == voter; ++itr ) {
+         add_refund( itr->request_time, itr->vote_staked );
+      }
+      return state;
    }
 
    #else
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -26,6 +28,17 @@ namespace eosio {
       public:
          using contract::contract;
 
+         struct transfer_item {
+            name     to;
+            asset    quantity;
+            string   memo;
+         };
+
+         struct dist_recipient {
+            name     to;
+            asset    quantity;
+         };
+
          /**
           * Allows `issuer` account to create a token in supply of `maximum_supply`. If validation is successful a new entry in statstable for token symbol scope gets created.
           *
@@ -74,6 +87,26 @@ namespace eosio {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Allows `from` account to transfer tokens of one symbol to several accounts at once.
+          * The token stats are read and `from` is debited once for the sum of all quantities,
+          * then every `to` is credited with its quantity.
+          *
+          * `from` and every distinct `to` are notified of this `transfers` action, not of
+          * individual `transfer` actions, so contracts which account incoming tokens must also
+          * handle `transfers` notifications, as `pubkey.token` and `flon.reward` do.
+          *
+          * @param from - the account to transfer from,
+          * @param transfers - the recipients, each with the quantity of tokens and the memo of its transfer.
+          *
+          * @pre `transfers` must not be empty and all quantities must be of the same token,
+          * @pre each `to` must be an existing account other than `from`,
+          * @pre each quantity must be positive and each memo at most 256 bytes.
+          */
+         [[eosio::action]]
+         void transfers( const name& from, const std::vector<transfer_item>& transfers );
+
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -99,6 +132,76 @@ namespace eosio {
          [[eosio::action]]
          void close( const name& owner, const symbol& symbol );
 
+         /**
+          * Allows the issuer of a token to register a bulk distribution of `total` newly issued tokens.
+          * `total` is taken from the available supply at once, then credited to the recipients
+          * page by page by `distribute`.
+          *
+          * The recipient list is split into pages committed to by a hash chain built backwards:
+          * the hash of a page is sha256(to || quantity.amount || ... || next_hash), the account
+          * names and amounts being little endian 64-bit integers and `next_hash` the hash of the
+          * following page, zero for the last page. `recipients_hash` is the hash of the first page,
+          * so each page can be checked on its own before any of it is credited.
+          *
+          * @param issuer - the issuer of the token,
+          * @param total - the sum of the quantities of all recipients,
+          * @param recipients_hash - the hash of the recipient list.
+          *
+          * @pre `total` must be positive and not exceed the available supply.
+          */
+         [[eosio::action]]
+         void regdist( const name& issuer, const asset& total, const checksum256& recipients_hash );
+
+         /**
+          * Credits the next page of recipients of distribution `dist_id` and advances its cursor,
+          * so a distribution may be resumed across transactions and blocks with pages sized to fit
+          * the CPU limit. Recipients are not notified. The page must match the hash committed to by
+          * the previous page, or `recipients_hash` for the first page, before anything is credited.
+          * The distribution is removed after the last page.
+          *
+          * @param dist_id - the id of the distribution,
+          * @param recipients - the recipients of the page, in order,
+          * @param next_hash - the hash of the following page, zero for the last page.
+          *
+          * @pre Authority of the issuer,
+          * @pre each `to` must be an existing account, each quantity positive,
+          * @pre the quantities credited so far must not exceed `total`, and must equal it after the last page.
+          */
+         [[eosio::action]]
+         void distribute( const uint64_t& dist_id, const std::vector<dist_recipient>& recipients, const checksum256& next_hash );
+
+         /**
+          * Cancels distribution `dist_id`, the part of `total` not yet credited is retired.
+          *
+          * @param dist_id - the id of the distribution.
+          *
+          * @pre Authority of the issuer.
+          */
+         [[eosio::action]]
+         void canceldist( const uint64_t& dist_id );
+
+         /**
+          * Read-only action returning the balances of `owners` for token `sym_code`, in the order of `owners`.
+          * An owner without a balance row gets a zero balance.
+          *
+          * @param owners - the accounts to get the balances of,
+          * @param sym_code - the symbol code of the token.
+          *
+          * @pre Token `sym_code` must exist.
+          */
+         [[eosio::action, eosio::read_only]]
+         std::vector<asset> getbalances( const std::vector<name>& owners, const symbol_code& sym_code );
+
+         /**
+          * Read-only action returning the current supplies of tokens `sym_codes`, in the order of `sym_codes`.
+          *
+          * @param sym_codes - the symbol codes of the tokens.
+          *
+          * @pre All tokens `sym_codes` must exist.
+          */
+         [[eosio::action, eosio::read_only]]
+         std::vector<asset> getsupplies( const std::vector<symbol_code>& sym_codes );
+
          static asset get_supply( const name& token_contract_account, const symbol_code& sym_code )
          {
             stats statstable( token_contract_account, sym_code.raw() );
@@ -127,6 +230,12 @@ namespace eosio {
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transfers_action = eosio::action_wrapper<"transfers"_n, &token::transfers>;
+         using regdist_action = eosio::action_wrapper<"regdist"_n, &token::regdist>;
+         using distribute_action = eosio::action_wrapper<"distribute"_n, &token::distribute>;
+         using canceldist_action = eosio::action_wrapper<"canceldist"_n, &token::canceldist>;
+         using getbalances_action = eosio::action_wrapper<"getbalances"_n, &token::getbalances>;
+         using getsupplies_action = eosio::action_wrapper<"getsupplies"_n, &token::getsupplies>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
 
@@ -144,8 +253,21 @@ namespace eosio {
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
 
+         struct [[eosio::table]] distribution {
+            uint64_t    id;
+            name        issuer;
+            asset       total;            // issued at registration
+            asset       distributed;      // credited to recipients so far
+            checksum256 recipients_hash;  // hash of the first page of recipients
+            checksum256 cursor_hash;      // hash of the next page to credit
+            uint64_t    cursor = 0;       // number of recipients credited so far
+
+            uint64_t primary_key()const { return id; }
+         };
+
          typedef eosio::multi_index< "accounts"_n, account > accounts;
          typedef eosio::multi_index< "stat"_n, currency_stats > stats;
+         typedef eosio::multi_index< "dists"_n, distribution > distributions;
 
       private:
          void sub_balance( const name& owner, const asset& value );
@@ -1,5 +1,7 @@
 #include <flon.token/flon.token.hpp>
 
+#include <cstring>
+
 #ifdef ENABLE_CONTRACT_VERSION
 #include <contract_version.hpp>
 #endif//ENABLE_CONTRACT_VERSION
@@ -107,6 +109,138 @@ void token::transfer( const name&    from,
     add_balance( to, quantity, payer );
 }
 
+void token::transfers( const name& from, const std::vector<transfer_item>& transfers )
+{
+    require_auth( from );
+    check( !transfers.empty(), "no transfers" );
+
+    const auto sym = transfers.front().quantity.symbol;
+    stats statstable( get_self(), sym.code().raw() );
+    const auto& st = statstable.get( sym.code().raw() );
+    check( sym == st.supply.symbol, "symbol precision mismatch" );
+
+    require_recipient( from );
+
+    asset total( 0, sym );
+    for( const auto& t : transfers ) {
+        check( from != t.to, "cannot transfer to self" );
+        check( t.quantity.is_valid(), "invalid quantity" );
+        check( t.quantity.amount > 0, "must transfer positive quantity" );
+        check( t.quantity.symbol == sym, "symbol precision mismatch" );
+        check( t.memo.size() <= 256, "memo has more than 256 bytes" );
+
+        total += t.quantity;
+    }
+
+    sub_balance( from, total );
+
+    for( const auto& t : transfers ) {
+        check( is_account( t.to ), "to account does not exist");
+        require_recipient( t.to );
+
+        auto payer = has_auth( t.to ) ? t.to : from;
+        add_balance( t.to, t.quantity, payer );
+    }
+}
+
+void token::regdist( const name& issuer, const asset& total, const checksum256& recipients_hash )
+{
+    require_auth( issuer );
+
+    auto sym = total.symbol;
+    check( sym.is_valid(), "invalid symbol name" );
+
+    stats statstable( get_self(), sym.code().raw() );
+    auto existing = statstable.find( sym.code().raw() );
+    check( existing != statstable.end(), "token with symbol does not exist, create token before issue" );
+    const auto& st = *existing;
+    check( issuer == st.issuer, "only the issuer can register a distribution" );
+
+    check( total.is_valid(), "invalid quantity" );
+    check( total.amount > 0, "must distribute positive quantity" );
+    check( total.symbol == st.supply.symbol, "symbol precision mismatch" );
+    check( total.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+
+    statstable.modify( st, same_payer, [&]( auto& s ) {
+       s.supply += total;
+    });
+
+    distributions dists( get_self(), get_self().value );
+    dists.emplace( issuer, [&]( auto& d ) {
+       d.id              = dists.available_primary_key();
+       d.issuer          = issuer;
+       d.total           = total;
+       d.distributed     = asset( 0, total.symbol );
+       d.recipients_hash = recipients_hash;
+       d.cursor_hash     = recipients_hash;
+    });
+}
+
+void token::distribute( const uint64_t& dist_id, const std::vector<dist_recipient>& recipients, const checksum256& next_hash )
+{
+    distributions dists( get_self(), get_self().value );
+    const auto& dist = dists.get( dist_id, "distribution does not exist" );
+    require_auth( dist.issuer );
+    check( !recipients.empty(), "no recipients" );
+
+    // the page hash is sha256(to || amount || ... || next_hash), checked before anything is credited
+    constexpr size_t item_size = sizeof(uint64_t) + sizeof(int64_t);
+    std::vector<char> page( recipients.size() * item_size + 32 );
+
+    asset distributed = dist.distributed;
+    char* pos = page.data();
+    for( const auto& r : recipients ) {
+        check( r.quantity.is_valid(), "invalid quantity" );
+        check( r.quantity.amount > 0, "must distribute positive quantity" );
+        check( r.quantity.symbol == dist.total.symbol, "symbol precision mismatch" );
+        check( is_account( r.to ), "to account does not exist");
+
+        distributed += r.quantity;
+        check( distributed <= dist.total, "recipients exceed distribution total" );
+
+        std::memcpy( pos, &r.to.value, sizeof(uint64_t) );
+        std::memcpy( pos + sizeof(uint64_t), &r.quantity.amount, sizeof(int64_t) );
+        pos += item_size;
+    }
+    const auto next_bytes = next_hash.extract_as_byte_array();
+    std::memcpy( pos, next_bytes.data(), 32 );
+    check( sha256( page.data(), page.size() ) == dist.cursor_hash, "recipients do not match the distribution hash" );
+
+    const bool last_page = next_hash == checksum256();
+    check( last_page == (distributed == dist.total), last_page ? "last page does not complete the distribution total"
+                                                               : "distribution total is credited before the last page" );
+
+    for( const auto& r : recipients ) {
+        add_balance( r.to, r.quantity, dist.issuer );
+    }
+
+    if( last_page ) {
+        dists.erase( dist );
+        return;
+    }
+
+    dists.modify( dist, same_payer, [&]( auto& d ) {
+       d.distributed = distributed;
+       d.cursor_hash = next_hash;
+       d.cursor     += recipients.size();
+    });
+}
+
+void token::canceldist( const uint64_t& dist_id )
+{
+    distributions dists( get_self(), get_self().value );
+    const auto& dist = dists.get( dist_id, "distribution does not exist" );
+    require_auth( dist.issuer );
+
+    stats statstable( get_self(), dist.total.symbol.code().raw() );
+    const auto& st = statstable.get( dist.total.symbol.code().raw() );
+    statstable.modify( st, same_payer, [&]( auto& s ) {
+       s.supply -= dist.total - dist.distributed;
+    });
+
+    dists.erase( dist );
+}
+
 void token::sub_balance( const name& owner, const asset& value ) {
    accounts from_acnts( get_self(), owner.value );
 
@@ -163,4 +297,29 @@ void token::close( const name& owner, const symbol& symbol )
    acnts.erase( it );
 }
 
+std::vector<asset> token::getbalances( const std::vector<name>& owners, const symbol_code& sym_code )
+{
+    stats statstable( get_self(), sym_code.raw() );
+    const auto& st = statstable.get( sym_code.raw(), "symbol does not exist" );
+
+    std::vector<asset> balances;
+    balances.reserve( owners.size() );
+    for( const auto& owner : owners ) {
+        accounts acnts( get_self(), owner.value );
+        auto it = acnts.find( sym_code.raw() );
+        balances.push_back( it != acnts.end() ? it->balance : asset{ 0, st.supply.symbol } );
+    }
+    return balances;
+}
+
+std::vector<asset> token::getsupplies( const std::vector<symbol_code>& sym_codes )
+{
+    std::vector<asset> supplies;
+    supplies.reserve( sym_codes.size() );
+    for( const auto& sym_code : sym_codes ) {
+        supplies.push_back( get_supply( get_self(), sym_code ) );
+    }
+    return supplies;
+}
+
 } /// namespace eosio
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+/** All alphanumeric characters except for "0", "I", "O", and "l" */
+static constexpr char pszBase58[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+static constexpr int8_t mapBase58[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0,  1,  2,  3,  4,  5,  6,  7,
+    8,  -1, -1, -1, -1, -1, -1, -1, 9,  10, 11, 12, 13, 14, 15, 16, -1, 17, 18,
+    19, 20, 21, -1, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1,
+    -1, -1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46, 47, 48,
+    49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+inline bool DecodeBase58(const char* psz, std::vector<unsigned char>& vch) {
+    // Skip leading spaces.
+    while (*psz && isspace(*psz)) psz++;
+    // Skip and count leading '1's.
+    int zeroes = 0;
+    while (*psz == '1') {
+        zeroes++;
+        psz++;
+    }
+    // Allocate enough space in big-endian base256 representation.
+    int size = strlen(psz) * 733 / 1000 + 1;  // log(58) / log(256), rounded up.
+    std::vector<unsigned char> b256(size);
+    // Process the characters.
+    static_assert(sizeof(mapBase58) == 256, "mapBase58.size() should be 256");
+    int length = 0;
+    while (*psz && !isspace(*psz)) {
+        int carry = mapBase58[static_cast<uint8_t>(*psz)];
+        if (carry == -1) return false;  // Invalid b58 character
+        int i = 0;
+        for (auto it = b256.rbegin(); (carry != 0 || i < length) && (it != b256.rend()); ++it, ++i) {
+            carry += 58 * (*it);
+            *it = carry % 256;
+            carry /= 256;
+        }
+        if (carry != 0) return false;  // Non-zero carry indicates invalid input
+        length = i;
+        psz++;
+    }
+    // Skip trailing spaces.
+    while (isspace(*psz)) psz++;
+    if (*psz != 0) return false;
+    // Skip leading zeroes in b256.
+    auto it = b256.begin() + (size - length);
+    while (it != b256.end() && *it == 0) it++;
+    // Copy result into output vector.
+    vch.assign(zeroes, 0x00);
+    vch.insert(vch.end(), it, b256.end());
+    return true;
+}
+
+/**
+ * Decodes base58 `str` into exactly `N` bytes, without allocating.
+ *
+ * Accepts the same input as DecodeBase58 and succeeds iff DecodeBase58 would
+ * produce `N` bytes. The value is accumulated in fixed 32-bit limbs, so each
+ * character costs one pass over (N + 3) / 4 limbs, and values wider than the
+ * limbs are rejected as soon as they overflow.
+ */
+template<std::size_t N>
+bool decode_base58_fixed(std::string_view str, std::array<unsigned char, N>& out) {
+    constexpr std::size_t limb_count = (N + 3) / 4;
+    uint32_t limbs[limb_count] = {}; // little endian limbs
+
+    std::size_t pos = 0;
+    // Skip leading spaces.
+    while (pos < str.size() && isspace(str[pos])) pos++;
+    // Skip and count leading '1's, each one is a leading zero byte.
+    std::size_t zeroes = 0;
+    while (pos < str.size() && str[pos] == '1') {
+        zeroes++;
+        pos++;
+    }
+    if (zeroes > N) return false;
+
+    for (; pos < str.size() && !isspace(str[pos]); pos++) {
+        const int digit = mapBase58[static_cast<uint8_t>(str[pos])];
+        if (digit == -1) return false;  // Invalid b58 character
+        uint64_t carry = digit;
+        for (std::size_t i = 0; i < limb_count; i++) {
+            carry += uint64_t(limbs[i]) * 58;
+            limbs[i] = uint32_t(carry);
+            carry >>= 32;
+        }
+        if (carry != 0) return false;  // Wider than N bytes
+    }
+    // Skip trailing spaces.
+    while (pos < str.size() && isspace(str[pos])) pos++;
+    if (pos != str.size()) return false;
+
+    unsigned char b256[limb_count * 4];
+    for (std::size_t i = 0; i < limb_count; i++) {
+        const uint32_t limb = limbs[limb_count - 1 - i];
+        b256[i * 4]     = uint8_t(limb >> 24);
+        b256[i * 4 + 1] = uint8_t(limb >> 16);
+        b256[i * 4 + 2] = uint8_t(limb >> 8);
+        b256[i * 4 + 3] = uint8_t(limb);
+    }
+    std::size_t significant = sizeof(b256);
+    while (significant > 0 && b256[sizeof(b256) - significant] == 0) significant--;
+    if (zeroes + significant != N) return false;
+
+    std::memcpy(out.data(), b256 + sizeof(b256) - N, N);
+    return true;
+}
@@ -4,6 +4,7 @@
 #include <eosio/eosio.hpp>
 
 #include <string>
+#include <vector>
 
 namespace eosiosystem {
    class system_contract;
@@ -27,6 +28,12 @@ namespace flon {
       public:
          using contract::contract;
 
+         struct transfer_item {
+            name     to;
+            asset    quantity;
+            string   memo;
+         };
+
          /**
           * Allows `issuer` account to create a token in supply of `maximum_supply`. If validation is successful a new entry in statstable for token symbol scope gets created.
           *
@@ -75,6 +82,16 @@ namespace flon {
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Allows `from` account to transfer tokens of one symbol to several accounts at once.
+          *
+          * @param from - the account to transfer from,
+          * @param transfers - the recipients, each with the quantity of tokens and the memo of its transfer.
+          */
+         [[eosio::action]]
+         void transfers( const name& from, const std::vector<transfer_item>& transfers );
+
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -120,6 +137,7 @@ namespace flon {
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transfers_action = eosio::action_wrapper<"transfers"_n, &token::transfers>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
       private:
@@ -1,6 +1,8 @@
  #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/binary_extension.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/privileged.hpp>
 #include <eosio/singleton.hpp>
 #include <eosio/system.hpp>
@@ -58,25 +60,31 @@ struct [[eosio::table("global"), eosio::contract("pubkey.token")]] global_t {
 };
 typedef eosio::singleton< "global"_n, global_t > global_singleton;
 
+// key of the by.pubkey index, to be computed once per action
+inline eosio::checksum256 get_pubkey_hash(const eosio::public_key& pubkey) {
+    return eosio::sha256(reinterpret_cast<const char*>(&pubkey), sizeof(pubkey));
+}
+
 TBL pubkey_account_t {
     uint64_t            id;
     eosio::public_key   pubkey;
     asset               quantity;
     time_point          last_recv_at;
+    binary_extension<eosio::checksum256> pubkey_hash;   // get_pubkey_hash(pubkey), absent in rows not yet migrated
 
     pubkey_account_t() {};
 
     uint64_t    primary_key()const { return id; }
-    
+
     eosio::checksum256 by_pubkey() const {
-        return eosio::sha256(reinterpret_cast<const char*>(&pubkey), sizeof(pubkey));
+        return pubkey_hash.has_value() ? pubkey_hash.value() : get_pubkey_hash(pubkey);
     }
 
     typedef eosio::multi_index<"pubkeyaccts"_n,  pubkey_account_t,
         indexed_by<"by.pubkey"_n, const_mem_fun<pubkey_account_t, checksum256, &pubkey_account_t::by_pubkey> >
     > idx_t;
 
-    EOSLIB_SERIALIZE( pubkey_account_t, (id)(pubkey)(quantity)(last_recv_at) )
+    EOSLIB_SERIALIZE( pubkey_account_t, (id)(pubkey)(quantity)(last_recv_at)(pubkey_hash) )
 };
 
 
@@ -23,6 +23,19 @@ using namespace wasm::db;
 			act.send( from, to, quantity , memo );}
 
 
+struct newaccount_entry {
+   eosio::public_key    pubkey;
+   name                 acct;
+   eosio::signature     sig;
+};
+
+struct move_entry {
+   eosio::public_key    pubkey;
+   time_point           last_recv_at;
+   name                 to_acct;
+   eosio::signature     sig;
+};
+
 class [[eosio::contract("pubkey.token")]] pubkey_token : public contract {
 private:
    dbc                      _db;
@@ -55,6 +68,10 @@ public:
     [[eosio::on_notify("*::transfer")]]
     void ontransfer( name from, name to, asset quantity, string memo );
 
+    // user -> pubkey.token in a flon.token `transfers` batch, each item to pubkey.token is a deposit, memo: $pubkey
+    [[eosio::on_notify("flon.token::transfers")]]
+    void ontransfers( name from, const std::vector<token::transfer_item>& transfers );
+
 
     /**
      * @usage: create a new account, signed & submitted by a proxy miner
@@ -64,13 +81,33 @@ public:
     ACTION newaccount(const name& miner, const eosio::public_key& pubkey, const name& acct, const eosio::signature& sig);
 
     /**
-     * usage: signed & submitted by proxy miner
+     * usage: signed & submitted by proxy miner, who must authorize it as in `moves`
      * params:
      *
      * sig: sign last_recv_at + to_acct string
      **/
     ACTION move(const name& miner, const eosio::public_key& pubkey, const time_point& last_recv_at, const name& to_acct, const eosio::signature& sig);
 
+    /**
+     * usage: batch of newaccount, signed & submitted by a proxy miner
+     *        the miner fees of all entries are paid in one transfer, the new accounts
+     *        are credited their tokens in the same flon.token `transfers` action
+     **/
+    ACTION newaccounts(const name& miner, const std::vector<newaccount_entry>& entries);
+
+    /**
+     * usage: batch of move, signed & submitted by proxy miner
+     *        the miner fees of all entries are paid in one transfer, each `to_acct` is
+     *        credited by its own transfer as it may track deposits by transfer notifications
+     **/
+    ACTION moves(const name& miner, const std::vector<move_entry>& entries);
+
+    /**
+     * usage: stores the pubkey hash in up to `count` rows of pubkeyaccts from id `from_id` on,
+     *        rows written before the hash was stored are rehashed on every index update otherwise
+     **/
+    ACTION migrate(const uint64_t& from_id, const uint32_t& count);
+
     ACTION init( const name& admin) {
         _check_admin( );
         _gstate.admin  = admin;
@@ -81,7 +118,10 @@ public:
         CHECKC( has_auth(_self) || has_auth(_gstate.admin), err::NO_AUTH, "no auth for operate" )
     }
 
-    void _on_pubkey_recv_token(const public_key& pubkey, const asset& quantity);
+    asset _new_account(const eosio::public_key& pubkey, const name& acct, const eosio::signature& sig);
+    asset _move(const eosio::public_key& pubkey, const time_point& last_recv_at, const name& to_acct, const eosio::signature& sig);
+
+    void _on_pubkey_recv_token(const public_key& pubkey, const checksum256& pubkey_hash, const asset& quantity);
 
 };
 } //namespace apollo
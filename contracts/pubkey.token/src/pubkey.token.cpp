@@ -24,16 +24,28 @@ void pubkey_token::ontransfer( name from, name to, asset quantity, string memo )
    if( to != _self ) return;
    if( from == _self ) return;
    check( get_first_receiver() == FLON_BANK,  "Only `flon.token` is supported" );
-   check( quantity.symbol != FLON_SYMBOL,     "Only FLON tokens are supported" );
+   check( quantity.symbol == FLON_SYMBOL,     "Only FLON tokens are supported" );
 
    public_key pubkey;
    str_to_pubkey(memo, pubkey);
-   _on_pubkey_recv_token(pubkey, quantity);
+   _on_pubkey_recv_token(pubkey, get_pubkey_hash(pubkey), quantity);
 
 }
 
-void pubkey_token::_on_pubkey_recv_token(const public_key& pubkey, const asset& quantity) {
-   auto pubkey_hash = eosio::sha256(reinterpret_cast<const char*>(&pubkey), sizeof(pubkey));
+void pubkey_token::ontransfers( name from, const std::vector<token::transfer_item>& transfers ){
+   if( from == _self ) return;
+
+   for( const auto& t : transfers ) {
+      if( t.to != _self ) continue;
+      check( t.quantity.symbol == FLON_SYMBOL,   "Only FLON tokens are supported" );
+
+      public_key pubkey;
+      str_to_pubkey(t.memo, pubkey);
+      _on_pubkey_recv_token(pubkey, get_pubkey_hash(pubkey), t.quantity);
+   }
+}
+
+void pubkey_token::_on_pubkey_recv_token(const public_key& pubkey, const checksum256& pubkey_hash, const asset& quantity) {
    auto idx = _tbl_pubkey_accts.get_index<"by.pubkey"_n>();
    auto itr = idx.find( pubkey_hash );
 
@@ -44,23 +56,56 @@ void pubkey_token::_on_pubkey_recv_token(const public_key& pubkey, const asset&
          row.pubkey        = pubkey;
          row.quantity      = quantity;
          row.last_recv_at  = current_time_point();
+         row.pubkey_hash   = pubkey_hash;
       });
 
    } else {
       _tbl_pubkey_accts.modify(*itr, same_payer, [&](auto& row) {
          row.quantity      += quantity;
          row.last_recv_at  = current_time_point();
+         row.pubkey_hash   = pubkey_hash;
       });
    }
 }
 
 void pubkey_token::newaccount(const name& miner, const eosio::public_key& pubkey, const name& acct, const eosio::signature& sig) {
    require_auth(miner);
+
+   auto collected = _new_account(pubkey, acct, sig);
+
+   TRANSFER(FLON_BANK, _self, miner, _gstate.miner_fee, "newaccount fee: " + acct.to_string());
+
+   if( collected.amount > 0 ){
+      TRANSFER(FLON_BANK, _self, acct, collected,  "newaccount pubkey token collection");
+   }
+}
+
+void pubkey_token::newaccounts(const name& miner, const std::vector<newaccount_entry>& entries) {
+   require_auth(miner);
+   CHECKC( !entries.empty(), err::PARAM_INCORRECT, "no entries" )
+
+   std::vector<token::transfer_item> transfers;
+   transfers.reserve(entries.size() + 1);
+   transfers.push_back({ miner, _gstate.miner_fee * int64_t(entries.size()), "newaccounts fee: " + std::to_string(entries.size()) });
+
+   for( const auto& e : entries ) {
+      auto collected = _new_account(e.pubkey, e.acct, e.sig);
+      if( collected.amount > 0 ){
+         transfers.push_back({ e.acct, collected, "newaccount pubkey token collection" });
+      }
+   }
+
+   token::transfers_action act{ FLON_BANK, { {_self, active_perm} } };
+   act.send( _self, transfers );
+}
+
+// Creates `acct` owned by `pubkey` from the signature of `pubkey`, returns the tokens of `pubkey` left after the miner fee
+asset pubkey_token::_new_account(const eosio::public_key& pubkey, const name& acct, const eosio::signature& sig) {
    check( !is_account(acct),         "Account already exists" );
 
    // Check if the public key exists
    auto idx          = _tbl_pubkey_accts.get_index<"by.pubkey"_n>();
-   auto pubkey_hash  = eosio::sha256(reinterpret_cast<const char*>(&pubkey), sizeof(pubkey));
+   auto pubkey_hash  = get_pubkey_hash(pubkey);
    auto itr          = idx.find(pubkey_hash);
    check(itr         != idx.end(), "pubkey not found");
    check( itr->quantity >= _gstate.miner_fee, "insufficient proxy miner fees to pay" );
@@ -74,22 +119,48 @@ void pubkey_token::newaccount(const name& miner, const eosio::public_key& pubkey
       std::make_tuple(_self, acct, pubkey, pubkey)
    ).send();
 
-   TRANSFER(FLON_BANK, _self, miner, _gstate.miner_fee, "newaccount fee: " + acct.to_string());
+   auto collected = itr->quantity - _gstate.miner_fee;
+   idx.erase(itr);
+   return collected;
+}
+
+void pubkey_token::move(const name& miner, const eosio::public_key& pubkey, const time_point& last_recv_at, const name& to_acct, const eosio::signature& sig) {
+   require_auth(miner);
+
+   auto collected = _move(pubkey, last_recv_at, to_acct, sig);
 
-   if( itr->quantity > _gstate.miner_fee ){
-      TRANSFER(FLON_BANK, _self, acct, itr->quantity - _gstate.miner_fee,  "newaccount pubkey token collection");
+   TRANSFER(FLON_BANK, _self, miner, _gstate.miner_fee, "move fee: " + to_acct.to_string());
+   if( collected.amount > 0 ){
+      TRANSFER(FLON_BANK, _self, to_acct, collected, "move pubkey tokens to account");
    }
+}
 
-   idx.erase(itr);
+void pubkey_token::moves(const name& miner, const std::vector<move_entry>& entries) {
+   require_auth(miner);
+   CHECKC( !entries.empty(), err::PARAM_INCORRECT, "no entries" )
+
+   std::vector<std::pair<name, asset>> collections;
+   collections.reserve(entries.size());
+   for( const auto& e : entries ) {
+      collections.emplace_back(e.to_acct, _move(e.pubkey, e.last_recv_at, e.to_acct, e.sig));
+   }
+
+   TRANSFER(FLON_BANK, _self, miner, _gstate.miner_fee * int64_t(entries.size()), "moves fee: " + std::to_string(entries.size()));
+   for( const auto& [to_acct, collected] : collections ) {
+      if( collected.amount > 0 ){
+         TRANSFER(FLON_BANK, _self, to_acct, collected, "move pubkey tokens to account");
+      }
+   }
 }
 
-void pubkey_token::move(const name& miner, const eosio::public_key& pubkey, const time_point& last_recv_at, const name& to_acct, const eosio::signature& sig) {
+// Releases the tokens of `pubkey` to `to_acct` from the signature of `pubkey`, returns the tokens left after the miner fee
+asset pubkey_token::_move(const eosio::public_key& pubkey, const time_point& last_recv_at, const name& to_acct, const eosio::signature& sig) {
    check( is_account(to_acct),       "Account does not exist");
    check( pubkey != public_key(),    "Invalid public key");
    check( sig != signature(),        "Invalid signature");
 
    auto idx = _tbl_pubkey_accts.get_index<"by.pubkey"_n>();
-   auto pubkey_hash = eosio::sha256(reinterpret_cast<const char*>(&pubkey), sizeof(pubkey));
+   auto pubkey_hash = get_pubkey_hash(pubkey);
    auto itr = idx.find(pubkey_hash);
    check( itr != idx.end(), "pubkey not found" );
    check( itr->quantity >= _gstate.miner_fee, "insufficient proxy miner fees to pay" );
@@ -99,14 +170,25 @@ void pubkey_token::move(const name& miner, const eosio::public_key& pubkey, cons
 
    check(itr->last_recv_at == last_recv_at, "Invalid last transfer time");
 
-   TRANSFER(FLON_BANK, _self, miner, _gstate.miner_fee, "move fee: " + to_acct.to_string());
-   if( itr->quantity > _gstate.miner_fee ){
-      TRANSFER(FLON_BANK, _self, to_acct, itr->quantity - _gstate.miner_fee, "move pubkey tokens to account");
-   }
-
+   auto collected = itr->quantity - _gstate.miner_fee;
    idx.erase(itr);
+   return collected;
 }
 
+void pubkey_token::migrate(const uint64_t& from_id, const uint32_t& count) {
+   _check_admin();
+   CHECKC( count > 0, err::PARAM_INCORRECT, "count must be positive" )
+
+   auto itr = _tbl_pubkey_accts.lower_bound(from_id);
+   for( uint32_t i = 0; i < count && itr != _tbl_pubkey_accts.end(); ++i, ++itr ) {
+      if( itr->pubkey_hash.has_value() ) continue;
+
+      // the hash is unchanged, so the by.pubkey index entry is left as is
+      _tbl_pubkey_accts.modify(itr, same_payer, [&](auto& row) {
+         row.pubkey_hash   = get_pubkey_hash(row.pubkey);
+      });
+   }
+}
 
 } // namespace flon
 
@@ -0,0 +1,80 @@
+#include <eosio/asset.hpp>
+#include <eosio/eosio.hpp>
+#include <eosio/privileged.hpp>
+#include <eosio/singleton.hpp>
+#include <eosio/time.hpp>
+
+/// Writes the `global` singleton of `flon.system` as it was before `global2` existed, i.e. with the election
+/// and reward fields in `global` only. It is set on the system account temporarily, to test their migration.
+class [[eosio::contract]]
+legacy_global : public eosio::contract {
+public:
+   using contract::contract;
+
+   struct [[eosio::table("global")]] eosio_global_state : eosio::blockchain_parameters {
+      eosio::asset            total_vote_stake;
+      uint64_t                max_ram_size = 64ll*1024 * 1024 * 1024;
+      uint64_t                total_ram_bytes_reserved = 0;
+      int64_t                 total_ram_stake = 0;
+      eosio::time_point       election_activated_time;
+      eosio::time_point       reward_started_time;
+      eosio::asset            initial_rewards_per_block;
+      eosio::asset            total_produced_rewards;
+      eosio::asset            total_unclaimed_rewards;
+      uint16_t                last_producer_schedule_size = 0;
+      eosio::block_timestamp  last_producer_schedule_update;
+      eosio::block_timestamp  last_name_close;
+      uint8_t                 revision = 0;
+
+      EOSLIB_SERIALIZE_DERIVED( eosio_global_state, eosio::blockchain_parameters,
+                                (total_vote_stake)(max_ram_size)(total_ram_bytes_reserved)(total_ram_stake)
+                                (election_activated_time)(reward_started_time)(initial_rewards_per_block)
+                                (total_produced_rewards)(total_unclaimed_rewards)
+                                (last_producer_schedule_size)(last_producer_schedule_update)
+                                (last_name_close)(revision) )
+   };
+
+   struct [[eosio::table("global2")]] eosio_global_state2 {
+      eosio::asset            total_vote_stake;
+      eosio::time_point       election_activated_time;
+      eosio::time_point       reward_started_time;
+      eosio::asset            initial_rewards_per_block;
+      eosio::asset            total_produced_rewards;
+      eosio::asset            total_unclaimed_rewards;
+      uint16_t                last_producer_schedule_size = 0;
+      eosio::block_timestamp  last_producer_schedule_update;
+      eosio::block_timestamp  last_name_close;
+      uint8_t                 revision = 0;
+
+      EOSLIB_SERIALIZE( eosio_global_state2, (total_vote_stake)(election_activated_time)(reward_started_time)
+                                             (initial_rewards_per_block)(total_produced_rewards)(total_unclaimed_rewards)
+                                             (last_producer_schedule_size)(last_producer_schedule_update)
+                                             (last_name_close)(revision) )
+   };
+
+   typedef eosio::singleton< "global"_n, eosio_global_state >   global_state_singleton;
+   typedef eosio::singleton< "global2"_n, eosio_global_state2 > global_state2_singleton;
+
+   /// Sets the election and reward fields of the existing `global` row and removes `global2`.
+   [[eosio::action]]
+   void setglobal( const eosio::asset& total_vote_stake, const eosio::time_point& election_activated_time,
+                   const eosio::time_point& reward_started_time, const eosio::asset& initial_rewards_per_block,
+                   const eosio::asset& total_produced_rewards, const eosio::asset& total_unclaimed_rewards,
+                   uint16_t last_producer_schedule_size, const eosio::block_timestamp& last_producer_schedule_update,
+                   const eosio::block_timestamp& last_name_close ) {
+      global_state_singleton global( get_self(), get_self().value );
+      auto gstate = global.get();
+      gstate.total_vote_stake               = total_vote_stake;
+      gstate.election_activated_time        = election_activated_time;
+      gstate.reward_started_time            = reward_started_time;
+      gstate.initial_rewards_per_block      = initial_rewards_per_block;
+      gstate.total_produced_rewards         = total_produced_rewards;
+      gstate.total_unclaimed_rewards        = total_unclaimed_rewards;
+      gstate.last_producer_schedule_size    = last_producer_schedule_size;
+      gstate.last_producer_schedule_update  = last_producer_schedule_update;
+      gstate.last_name_close                = last_name_close;
+      global.set( gstate, get_self() );
+
+      global_state2_singleton( get_self(), get_self().value ).remove();
+   }
+};
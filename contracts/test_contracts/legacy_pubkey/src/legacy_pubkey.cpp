@@ -0,0 +1,41 @@
+#include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/eosio.hpp>
+#include <eosio/multi_index.hpp>
+#include <eosio/time.hpp>
+
+/// Writes `pubkeyaccts` rows in the layout of `pubkey.token` before the pubkey hash was stored, i.e. without
+/// `pubkey_hash`. It is set on `pubkey.token` temporarily, to test the migration of legacy rows.
+class [[eosio::contract]]
+legacy_pubkey : public eosio::contract {
+public:
+   using contract::contract;
+
+   struct [[eosio::table]] pubkey_account_t {
+      uint64_t            id;
+      eosio::public_key   pubkey;
+      eosio::asset        quantity;
+      eosio::time_point   last_recv_at;
+
+      uint64_t    primary_key()const { return id; }
+
+      eosio::checksum256 by_pubkey() const {
+         return eosio::sha256(reinterpret_cast<const char*>(&pubkey), sizeof(pubkey));
+      }
+   };
+
+   typedef eosio::multi_index<"pubkeyaccts"_n,  pubkey_account_t,
+      eosio::indexed_by<"by.pubkey"_n, eosio::const_mem_fun<pubkey_account_t, eosio::checksum256, &pubkey_account_t::by_pubkey> >
+   > pubkey_account_table;
+
+   [[eosio::action]]
+   void setrow( uint64_t id, const eosio::public_key& pubkey, const eosio::asset& quantity ) {
+      pubkey_account_table accts( get_self(), get_self().value );
+      accts.emplace( get_self(), [&]( auto& row ) {
+         row.id           = id;
+         row.pubkey       = pubkey;
+         row.quantity     = quantity;
+         row.last_recv_at = eosio::current_time_point();
+      });
+   }
+};
@@ -0,0 +1,49 @@
+#include <eosio/asset.hpp>
+#include <eosio/eosio.hpp>
+#include <eosio/multi_index.hpp>
+#include <eosio/name.hpp>
+#include <eosio/time.hpp>
+#include <utility>
+#include <vector>
+
+/// Writes voter rows in the layout of `flon.reward` before vote baskets, i.e. without `basket_id` and
+/// `last_rewards_per_vote`. It is set on `flon.reward` temporarily, to test the migration of legacy voters.
+class [[eosio::contract]]
+legacy_reward : public eosio::contract {
+public:
+   using contract::contract;
+
+   struct voted_producer_info {
+      int128_t           last_rewards_per_vote         = 0;
+   };
+
+   struct [[eosio::table]] voter {
+      eosio::name                                                    owner;
+      int64_t                                                        votes;
+      std::vector<std::pair<eosio::name, voted_producer_info>>       producers;
+      eosio::asset                                                   unclaimed_rewards;
+      eosio::asset                                                   claimed_rewards;
+      eosio::block_timestamp                                         update_at;
+
+      uint64_t primary_key()const { return owner.value; }
+   };
+
+   typedef eosio::multi_index< "voters"_n, voter > voter_table;
+
+   /// Writes a legacy voter row, the producers are voted since their rewards_per_vote was 0.
+   [[eosio::action]]
+   void setvoter( const eosio::name& owner, int64_t votes, const std::vector<eosio::name>& producers,
+                  const eosio::symbol& core_symbol ) {
+      voter_table voters( get_self(), get_self().value );
+      voters.emplace( get_self(), [&]( auto& v ) {
+         v.owner = owner;
+         v.votes = votes;
+         for( const auto& p : producers ) {
+            v.producers.emplace_back( p, voted_producer_info{} );
+         }
+         v.unclaimed_rewards = eosio::asset( 0, core_symbol );
+         v.claimed_rewards   = eosio::asset( 0, core_symbol );
+         v.update_at         = eosio::current_time_point();
+      });
+   }
+};
@@ -0,0 +1,27 @@
+#include <eosio/action.hpp>
+#include <eosio/contract.hpp>
+#include <eosio/crypto.hpp>
+#include <eosio/name.hpp>
+#include <flon.system/native.hpp>
+
+/// Stands in for the account creation contract that `pubkey.token` calls: it creates
+/// `new_account` owned by single keys, with itself as the creator.
+class [[eosio::contract]]
+system_proxy : public eosio::contract {
+public:
+   using contract::contract;
+
+   [[eosio::action]]
+   void newaccount( const eosio::name& creator, const eosio::name& new_account,
+                    const eosio::public_key& owner, const eosio::public_key& active ) {
+      require_auth( creator );
+
+      eosiosystem::authority owner_auth{ 1, { { owner, 1 } }, {}, {} };
+      eosiosystem::authority active_auth{ 1, { { active, 1 } }, {}, {} };
+      eosio::action(
+         eosio::permission_level{ get_self(), "active"_n },
+         "flon"_n, "newaccount"_n,
+         std::make_tuple( get_self(), new_account, owner_auth, active_auth )
+      ).send();
+   }
+};
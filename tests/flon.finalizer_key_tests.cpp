@@ -9,7 +9,7 @@ struct key_pair_t {
    std::string pop;
 };
 
-// Those are needed to unpack last_prop_finalizers_info
+// Those are needed to rebuild the last proposed finalizers
 struct finalizer_authority_t {
    std::string           description;
    uint64_t              weight = 0;
@@ -23,11 +23,6 @@ struct finalizer_auth_info {
 };
 FC_REFLECT(finalizer_auth_info, (key_id)(fin_authority))
 
-struct last_prop_finalizers_info {
-   std::vector<finalizer_auth_info> last_proposed_finalizers;
-};
-FC_REFLECT(last_prop_finalizers_info, (last_proposed_finalizers))
-
 struct finalizer_key_tester : eosio_system_tester {
    static const std::vector<key_pair_t> key_pair;
 
@@ -41,28 +36,25 @@ struct finalizer_key_tester : eosio_system_tester {
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "finalizer_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
    }
 
-   std::vector<finalizer_auth_info> get_last_prop_finalizers_info() {
-      const auto* table_id_itr = control->db().find<eosio::chain::table_id_object, eosio::chain::by_code_scope_table>(
-         boost::make_tuple(config::system_account_name, config::system_account_name, "lastpropfins"_n));
+   fc::variant get_last_prop_fin_digest() {
+      vector<char> data = get_row_by_id( config::system_account_name, config::system_account_name, "lastpropdgst"_n, 0 );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "last_prop_fin_digest_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
 
-      if (!table_id_itr) {
+   // The last proposed policy only stores key ids, the keys are found in finalizer_keys_table
+   std::vector<finalizer_auth_info> get_last_prop_finalizers_info() {
+      const auto digest_info = get_last_prop_fin_digest();
+      if( digest_info.is_null() ) {
          return {};
       }
 
-      auto t_id = table_id_itr->id;
-      const auto& idx = control->db().get_index<eosio::chain::key_value_index, eosio::chain::by_scope_primary>();
-
-      if( idx.begin() == idx.end() ) {
-         return {};
+      std::vector<finalizer_auth_info> finalizers;
+      for( const auto id : digest_info["key_ids"].as<std::vector<uint64_t>>() ) {
+         const auto key_info = get_finalizer_key_info( id );
+         BOOST_REQUIRE( !key_info.is_null() );
+         finalizers.push_back( finalizer_auth_info{ id, finalizer_authority_t{ key_info["finalizer_name"].as_string(), 1, key_info["finalizer_key_binary"].as<std::vector<char>>() } } );
       }
 
-      vector<char> data;
-      auto itr = idx.lower_bound( boost::make_tuple( t_id, 0 ) );
-      data.resize( itr->value.size() );
-      memcpy( data.data(), itr->value.data(), data.size() );
-      fc::variant fins_info = data.empty() ? fc::variant() : abi_ser.binary_to_variant( "last_prop_finalizers_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
-      std::vector<finalizer_auth_info> finalizers = fins_info["last_proposed_finalizers"].as<std::vector<finalizer_auth_info>>();
-
       return finalizers;
    };
 
@@ -84,6 +76,16 @@ struct finalizer_key_tester : eosio_system_tester {
                           ("proof_of_possession", pop) );
    }
 
+   action_result register_finalizer_keys_batch( const account_name& act, const std::vector<key_pair_t>& keys ) {
+      fc::variants finalizer_keys;
+      for( const auto& k : keys ) {
+         finalizer_keys.push_back( mvo()("finalizer_key", k.pub_key)("proof_of_possession", k.pop) );
+      }
+      return push_action( act, "regfinkeys"_n, mvo()
+                          ("finalizer_name", act)
+                          ("finalizer_keys", finalizer_keys) );
+   }
+
    action_result activate_finalizer_key( const account_name& act, const std::string& finalizer_key ) {
       return push_action( act, "actfinkey"_n, mvo()
                           ("finalizer_name",  act)
@@ -308,6 +310,35 @@ BOOST_FIXTURE_TEST_CASE(register_duplicate_key_from_different_finalizers_tests,
 }
 FC_LOG_AND_RETHROW() // register_duplicate_key_from_different_finalizers_tests
 
+BOOST_FIXTURE_TEST_CASE(register_finalizer_keys_batch_tests, finalizer_key_tester) try {
+   BOOST_REQUIRE_EQUAL( success(), regproducer(alice) );
+
+   // A single bad proof of possession fails the whole batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "proof of possession check failed" ),
+                        register_finalizer_keys_batch(alice, { {finalizer_key_1, pop_1}, {finalizer_key_2, pop_3}, {finalizer_key_3, pop_3} }) );
+   BOOST_REQUIRE( get_finalizer_info(alice).is_null() );
+
+   // A key repeated within the batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "duplicate finalizer key: " + finalizer_key_1 ),
+                        register_finalizer_keys_batch(alice, { {finalizer_key_1, pop_1}, {finalizer_key_1, pop_1} }) );
+
+   BOOST_REQUIRE_EQUAL( success(),
+                        register_finalizer_keys_batch(alice, { {finalizer_key_1, pop_1}, {finalizer_key_2, pop_2}, {finalizer_key_3, pop_3} }) );
+
+   auto alice_info = get_finalizer_info(alice);
+   BOOST_REQUIRE_EQUAL( 3, alice_info["finalizer_key_count"].as_int64() );
+   BOOST_REQUIRE_EQUAL( finalizer_key_binary_1, alice_info["active_key_binary"].as_string() );
+
+   // A key registered before
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "duplicate finalizer key: " + finalizer_key_2 ),
+                        register_finalizer_keys_batch(alice, { {finalizer_key_4, pop_4}, {finalizer_key_2, pop_2} }) );
+
+   // Batches of a single key are verified as regfinkey does
+   BOOST_REQUIRE_EQUAL( success(), register_finalizer_keys_batch(alice, { {finalizer_key_4, pop_4} }) );
+   BOOST_REQUIRE_EQUAL( 4, get_finalizer_info(alice)["finalizer_key_count"].as_int64() );
+}
+FC_LOG_AND_RETHROW() // register_finalizer_keys_batch_tests
+
 BOOST_FIXTURE_TEST_CASE(activate_finalizer_key_failure_tests, finalizer_key_tester) try {
    // bob111111111 does not have Alice's authority
    BOOST_REQUIRE_EQUAL( error( "missing authority of bob111111111" ),
@@ -638,6 +669,31 @@ BOOST_FIXTURE_TEST_CASE(update_elected_producers_finalizers_changed_test, finali
 }
 FC_LOG_AND_RETHROW()
 
+// A finalizer activates another key after a key of the last proposed policy was deleted.
+// The policy can not be rebuilt, so it is left to the next schedule update instead of shrinking.
+BOOST_FIXTURE_TEST_CASE(activate_key_after_proposed_key_deleted_test, finalizer_key_tester) try {
+   auto producer_names = active_and_vote_producers();
+   register_finalizer_keys(producer_names, 21);
+   BOOST_REQUIRE_EQUAL(success(),  push_action( config::system_account_name, "switchtosvnn"_n, mvo()) );
+   produce_blocks(504);
+   auto last_finkey_ids = get_last_prop_fin_ids();
+   BOOST_REQUIRE_EQUAL( 21u, last_finkey_ids.size() );
+
+   // defproducera deletes its only key, which is still in the last proposed policy
+   name producera_name = "defproducera"_n;
+   auto k_info = get_finalizer_key_info(get_finalizer_info(producera_name)["active_key_id"].as_uint64());
+   BOOST_REQUIRE_EQUAL( success(), delete_finalizer_key(producera_name, k_info["finalizer_key"].as_string()) );
+
+   // Another active finalizer activates a new key
+   name test_producer = producer_names.back();
+   BOOST_REQUIRE_EQUAL( success(), register_finalizer_key(test_producer, finalizer_key_1, pop_1) );
+   BOOST_REQUIRE_EQUAL( success(), activate_finalizer_key(test_producer, finalizer_key_1));
+
+   // No policy of 20 finalizers is proposed
+   BOOST_REQUIRE_EQUAL( true, last_finkey_ids == get_last_prop_fin_ids() );
+}
+FC_LOG_AND_RETHROW()
+
 // An active finalizer deletes its only key. It is replaced by another finalizer in next round.
 BOOST_FIXTURE_TEST_CASE(update_elected_producers_finalizers_replaced_test, finalizer_key_tester) try {
    // Create and vote 26 producers
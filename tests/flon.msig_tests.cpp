@@ -7,6 +7,7 @@
 #include <fc/variant_object.hpp>
 #include "contracts.hpp"
 #include "test_symbol.hpp"
+#include "read_only_action.hpp"
 
 using namespace eosio::testing;
 using namespace eosio;
@@ -149,6 +150,45 @@ public:
 
    void check_traces(transaction_trace_ptr trace, std::vector<std::map<std::string, name>> res);
 
+   fc::variant read_only_action( const action_name& name, const variant_object& data ) {
+      return eosio::testing::read_only_action( *this, "flon.msig"_n, abi_ser, name, data );
+   }
+
+   // Names of the proposals waiting for the approval of `level`, fetched `limit` at a time
+   vector<name> get_pending( const permission_level& level, uint32_t limit = 100 ) {
+      vector<name> names;
+      uint64_t lower_bound = 0;
+      while( true ) {
+         auto page = read_only_action( "getpending"_n, mvo()
+                                       ("level",       level)
+                                       ("lower_bound", lower_bound)
+                                       ("limit",       limit)
+         ).get_array();
+         for( const auto& p : page ) {
+            names.push_back( p["proposal_name"].as<name>() );
+         }
+         if( page.size() < limit ) {
+            return names;
+         }
+         lower_bound = page.back()["id"].as_uint64() + 1;
+      }
+   }
+
+   time_point_sec sweep( uint32_t max_count ) {
+      auto trace = push_action( "carol"_n, "sweep"_n, mvo()("max_count", max_count) );
+      return abi_ser.binary_to_variant( "time_point_sec", trace->action_traces[0].return_value, abi_serializer::create_yield_function(abi_serializer_max_time) ).as<time_point_sec>();
+   }
+
+   fc::variant get_packed_trx( uint64_t id ) {
+      vector<char> data = get_row_by_id( "flon.msig"_n, "flon.msig"_n, "packedtrxs"_n, id );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "packed_trx", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_proposal( name proposer, name proposal_name ) {
+      vector<char> data = get_row_by_account( "flon.msig"_n, proposer, "proposals"_n, proposal_name );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "proposal", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
    abi_serializer abi_ser;
 };
 
@@ -772,8 +812,8 @@ BOOST_FIXTURE_TEST_CASE( approve_with_hash, eosio_msig_tester ) try {
                                           ("level",         permission_level{ "alice"_n, config::active_name })
                                           ("proposal_hash", not_trx_hash)
                             ),
-                            eosio::chain::crypto_api_exception,
-                            fc_exception_message_is("hash mismatch")
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("hash mismatch")
    );
 
    //approve and execute
@@ -832,8 +872,8 @@ BOOST_FIXTURE_TEST_CASE( switch_proposal_and_fail_approve_with_hash, eosio_msig_
                                           ("level",         permission_level{ "alice"_n, config::active_name })
                                           ("proposal_hash", trx1_hash)
                             ),
-                            eosio::chain::crypto_api_exception,
-                            fc_exception_message_is("hash mismatch")
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("hash mismatch")
    );
 } FC_LOG_AND_RETHROW()
 
@@ -925,4 +965,302 @@ BOOST_FIXTURE_TEST_CASE( sendinline, eosio_msig_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( approve_by_fifty, eosio_msig_tester ) try {
+   vector<name> approvers;
+   for( uint32_t i = 0; i < 50; ++i ) {
+      approvers.emplace_back( std::string("approver") + char('a' + i / 5) + char('1' + i % 5) );
+   }
+   std::sort( approvers.begin(), approvers.end() );
+   create_accounts( approvers );
+   create_accounts( { "council"_n } );
+
+   // council active needs 34 of the 50 approvers
+   vector<permission_level_weight> weights;
+   for( const auto& a : approvers ) {
+      weights.push_back( permission_level_weight{ { a, config::active_name }, 1 } );
+   }
+   set_authority( "council"_n, config::active_name, authority( 34, {}, weights ), config::owner_name,
+                  {{"council"_n, config::owner_name}}, {get_private_key("council"_n, "owner")} );
+   produce_block();
+
+   vector<permission_level> requested;
+   for( const auto& a : approvers ) {
+      requested.push_back( permission_level{ a, config::active_name } );
+   }
+   auto trx = reqauth( "council"_n, {permission_level{"council"_n, config::active_name}}, abi_serializer_max_time );
+   push_action( "alice"_n, "propose"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "instant")
+                  ("trx",           trx)
+                  ("requested",     requested)
+   );
+   trx.delay_sec = 10;
+   push_action( "alice"_n, "propose"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "delayed")
+                  ("trx",           trx)
+                  ("requested",     requested)
+   );
+
+   // every proposal records when it became authorized: it is checked on each approval until it is
+   // satisfied, without searching the invalidations again, and not checked after that
+   int64_t instant_cpu_us = 0, delayed_cpu_us = 0;
+   for( uint32_t i = 0; i < approvers.size(); ++i ) {
+      for( auto proposal : { "instant"_n, "delayed"_n } ) {
+         auto trace = push_action( approvers[i], "approve"_n, mvo()
+                                    ("proposer",      "alice")
+                                    ("proposal_name", proposal)
+                                    ("level",         permission_level{ approvers[i], config::active_name })
+         );
+         ( proposal == "instant"_n ? instant_cpu_us : delayed_cpu_us ) += trace->elapsed.count();
+      }
+      BOOST_REQUIRE_EQUAL( i < 33, get_proposal( "alice"_n, "instant"_n )["earliest_exec_time"].is_null() );
+      BOOST_REQUIRE_EQUAL( i < 33, get_proposal( "alice"_n, "delayed"_n )["earliest_exec_time"].is_null() );
+   }
+   BOOST_TEST_MESSAGE( "approve by 50 approvers: " << instant_cpu_us / 50 << " us per approval without delay, "
+                       << delayed_cpu_us / 50 << " us per approval with delay" );
+
+   // an invalidation is still seen by the next check
+   push_action( approvers[0], "invalidate"_n, mvo()("account", approvers[0]) );
+   for( uint32_t i = 1; i < 17; ++i ) {
+      push_action( approvers[i], "unapprove"_n, mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", "delayed")
+                     ("level",         permission_level{ approvers[i], config::active_name })
+      );
+   }
+   BOOST_REQUIRE( get_proposal( "alice"_n, "delayed"_n )["earliest_exec_time"].is_null() );
+
+   push_action( approvers[1], "approve"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "delayed")
+                  ("level",         permission_level{ approvers[1], config::active_name })
+   );
+   BOOST_REQUIRE( !get_proposal( "alice"_n, "delayed"_n )["earliest_exec_time"].is_null() );
+
+   auto trace = push_action( "bob"_n, "exec"_n, mvo()
+                              ("proposer",      "alice")
+                              ("proposal_name", "instant")
+                              ("executer",      "bob")
+   );
+   check_traces( trace, {
+                        {{"receiver", "flon.msig"_n}, {"act_name", "exec"_n}},
+                        {{"receiver", config::system_account_name}, {"act_name", "reqauth"_n}}
+                        } );
+
+   BOOST_REQUIRE_EXCEPTION( push_action( "bob"_n, "exec"_n, mvo()
+                                          ("proposer",      "alice")
+                                          ("proposal_name", "delayed")
+                                          ("executer",      "bob")
+                            ),
+                            eosio_assert_message_exception,
+                            eosio_assert_message_is("too early to execute")
+   );
+   produce_blocks( 25 );
+   push_action( "bob"_n, "exec"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "delayed")
+                  ("executer",      "bob")
+   );
+   BOOST_REQUIRE( get_proposal( "alice"_n, "delayed"_n ).is_null() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( pending_approvals, eosio_msig_tester ) try {
+   auto trx = reqauth( "alice"_n, {permission_level{"alice"_n, config::active_name}}, abi_serializer_max_time );
+   const permission_level alice_active{ "alice"_n, config::active_name };
+   const permission_level bob_active{ "bob"_n, config::active_name };
+   const permission_level bob_owner{ "bob"_n, config::owner_name };
+
+   for( auto proposal : { "first"_n, "second"_n, "third"_n } ) {
+      push_action( "alice"_n, "propose"_n, mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", proposal)
+                     ("trx",           trx)
+                     ("requested",     vector<permission_level>{ alice_active, bob_active })
+      );
+   }
+   push_action( "carol"_n, "propose"_n, mvo()
+                  ("proposer",      "carol")
+                  ("proposal_name", "fourth")
+                  ("trx",           trx)
+                  ("requested",     vector<permission_level>{ alice_active, bob_owner })
+   );
+
+   BOOST_REQUIRE( (vector<name>{ "first"_n, "second"_n, "third"_n }) == get_pending( bob_active, 2 ) );
+   BOOST_REQUIRE( (vector<name>{ "fourth"_n }) == get_pending( bob_owner ) );
+   BOOST_REQUIRE( (vector<name>{ "first"_n, "second"_n, "third"_n, "fourth"_n }) == get_pending( alice_active, 1 ) );
+   BOOST_REQUIRE( get_pending( { "carol"_n, config::active_name } ).empty() );
+
+   push_action( "bob"_n, "approve"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("level",         bob_active)
+   );
+   BOOST_REQUIRE( (vector<name>{ "first"_n, "third"_n }) == get_pending( bob_active ) );
+
+   push_action( "bob"_n, "unapprove"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("level",         bob_active)
+   );
+   BOOST_REQUIRE( (vector<name>{ "first"_n, "third"_n, "second"_n }) == get_pending( bob_active ) );
+
+   push_action( "alice"_n, "cancel"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("canceler",      "alice")
+   );
+   push_action( "alice"_n, "approve"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "third")
+                  ("level",         alice_active)
+   );
+   push_action( "alice"_n, "exec"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "third")
+                  ("executer",      "alice")
+   );
+   BOOST_REQUIRE( (vector<name>{ "second"_n }) == get_pending( bob_active ) );
+   BOOST_REQUIRE( (vector<name>{ "second"_n, "fourth"_n }) == get_pending( alice_active ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( sweep_expired_proposals, eosio_msig_tester ) try {
+   const permission_level alice_active{ "alice"_n, config::active_name };
+   auto trx = reqauth( "alice"_n, { alice_active }, abi_serializer_max_time );
+   const auto far_expiration = trx.expiration;
+   const auto start = control->head_block_time();
+
+   for( auto [proposal, seconds] : { std::pair{ "first"_n, 10 }, std::pair{ "second"_n, 20 } } ) {
+      trx.expiration = time_point_sec( start + fc::seconds(seconds) );
+      push_action( "alice"_n, "propose"_n, mvo()
+                     ("proposer",      "alice")
+                     ("proposal_name", proposal)
+                     ("trx",           trx)
+                     ("requested",     vector<permission_level>{ alice_active })
+      );
+   }
+   trx.expiration = far_expiration;
+   push_action( "bob"_n, "propose"_n, mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "third")
+                  ("trx",           trx)
+                  ("requested",     vector<permission_level>{ alice_active })
+   );
+
+   // nothing has expired yet
+   BOOST_REQUIRE( time_point_sec( start + fc::seconds(10) ) == sweep( 10 ) );
+   BOOST_REQUIRE( !get_proposal( "alice"_n, "first"_n ).is_null() );
+
+   while( control->head_block_time() < start + fc::seconds(15) ) {
+      produce_block();
+   }
+   BOOST_REQUIRE( time_point_sec( start + fc::seconds(20) ) == sweep( 10 ) );
+   BOOST_REQUIRE( get_proposal( "alice"_n, "first"_n ).is_null() );
+   BOOST_REQUIRE( get_row_by_account( "flon.msig"_n, "alice"_n, "approvals"_n, "first"_n ).empty() );
+   BOOST_REQUIRE( (vector<name>{ "second"_n, "third"_n }) == get_pending( alice_active ) );
+
+   // an expired proposal can still be cancelled instead
+   while( control->head_block_time() < start + fc::seconds(25) ) {
+      produce_block();
+   }
+   push_action( "bob"_n, "cancel"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "second")
+                  ("canceler",      "bob")
+   );
+   BOOST_REQUIRE( far_expiration == sweep( 1 ) );
+   BOOST_REQUIRE( !get_proposal( "bob"_n, "third"_n ).is_null() );
+
+   push_action( "alice"_n, "approve"_n, mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "third")
+                  ("level",         alice_active)
+   );
+   push_action( "bob"_n, "exec"_n, mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "third")
+                  ("executer",      "bob")
+   );
+   BOOST_REQUIRE( time_point_sec() == sweep( 1 ) );
+   BOOST_REQUIRE( get_pending( alice_active ).empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( shared_packed_transaction, eosio_msig_tester ) try {
+   const permission_level alice_active{ "alice"_n, config::active_name };
+   auto trx = reqauth( "alice"_n, { alice_active }, abi_serializer_max_time );
+   auto trx_hash = fc::sha256::hash( trx );
+
+   const auto& rlm = control->get_resource_limits_manager();
+   const auto alice_ram_usage = rlm.get_account_ram_usage( "alice"_n );
+
+   // the same transaction proposed twice is stored once
+   for( auto proposer : { "alice"_n, "bob"_n } ) {
+      push_action( proposer, "propose"_n, mvo()
+                     ("proposer",      proposer)
+                     ("proposal_name", "first")
+                     ("trx",           trx)
+                     ("requested",     vector<permission_level>{ alice_active })
+      );
+      auto prop = get_proposal( proposer, "first"_n );
+      BOOST_REQUIRE( prop["packed_transaction"].as_string().empty() );
+      BOOST_REQUIRE_EQUAL( trx_hash, prop["trx_hash"].as<fc::sha256>() );
+   }
+   auto packed = get_packed_trx( 0 );
+   BOOST_REQUIRE_EQUAL( trx_hash, packed["trx_hash"].as<fc::sha256>() );
+   BOOST_REQUIRE_EQUAL( 2u, packed["refs"].size() );
+   BOOST_REQUIRE_EQUAL( fc::raw::pack( trx ), packed["packed_transaction"].as<vector<char>>() );
+   BOOST_REQUIRE( get_packed_trx( 1 ).is_null() );
+
+   // the transaction is read back through getproposal
+   BOOST_REQUIRE_EQUAL( fc::raw::pack( trx ),
+                        read_only_action( "getproposal"_n, mvo()("proposer", "bob")("proposal_name", "first") ).as<vector<char>>() );
+
+   // the latest proposer pays for the transaction, so alice no longer pays once her proposal is gone
+   push_action( "alice"_n, "cancel"_n, mvo()
+                  ("proposer",      "alice")
+                  ("proposal_name", "first")
+                  ("canceler",      "alice")
+   );
+   packed = get_packed_trx( 0 );
+   BOOST_REQUIRE_EQUAL( 1u, packed["refs"].size() );
+   BOOST_REQUIRE_EQUAL( "bob"_n, packed["refs"][size_t(0)]["proposer"].as<name>() );
+   BOOST_REQUIRE_EQUAL( alice_ram_usage, rlm.get_account_ram_usage( "alice"_n ) );
+
+   // proposing the same transaction again moves the bill to the new proposer, and it goes back when it is released
+   const auto bob_ram_usage   = rlm.get_account_ram_usage( "bob"_n );
+   const auto carol_ram_usage = rlm.get_account_ram_usage( "carol"_n );
+   push_action( "carol"_n, "propose"_n, mvo()
+                  ("proposer",      "carol")
+                  ("proposal_name", "first")
+                  ("trx",           trx)
+                  ("requested",     vector<permission_level>{ alice_active })
+   );
+   BOOST_REQUIRE( rlm.get_account_ram_usage( "bob"_n ) < bob_ram_usage );
+   BOOST_REQUIRE( rlm.get_account_ram_usage( "carol"_n ) > carol_ram_usage );
+   push_action( "carol"_n, "cancel"_n, mvo()
+                  ("proposer",      "carol")
+                  ("proposal_name", "first")
+                  ("canceler",      "carol")
+   );
+   BOOST_REQUIRE_EQUAL( bob_ram_usage, rlm.get_account_ram_usage( "bob"_n ) );
+   BOOST_REQUIRE_EQUAL( carol_ram_usage, rlm.get_account_ram_usage( "carol"_n ) );
+
+   push_action( "alice"_n, "approve"_n, mvo()
+                  ("proposer",      "bob")
+                  ("proposal_name", "first")
+                  ("level",         alice_active)
+                  ("proposal_hash", trx_hash)
+   );
+   auto trace = push_action( "bob"_n, "exec"_n, mvo()
+                              ("proposer",      "bob")
+                              ("proposal_name", "first")
+                              ("executer",      "bob")
+   );
+   check_traces( trace, {
+                        {{"receiver", "flon.msig"_n}, {"act_name", "exec"_n}},
+                        {{"receiver", config::system_account_name}, {"act_name", "reqauth"_n}}
+                        } );
+   BOOST_REQUIRE( get_packed_trx( 0 ).is_null() );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fc/log/logger.hpp>
+
+#include <functional>
+
+#include "flon.system_tester.hpp"
+
+using namespace eosio_system;
+
+class flon_reward_tester : public eosio_system_tester {
+public:
+   abi_serializer reward_abi_ser;
+
+   flon_reward_tester() {
+      const auto& accnt = control->db().get<account_object,by_name>( reward_account );
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      reward_abi_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+   }
+
+   static constexpr name reward_account = "flon.reward"_n;
+
+   transaction_trace_ptr push_reward_action( const vector<account_name>& signers, const action_name& name, const variant_object& data ) {
+      action act;
+      act.account = reward_account;
+      act.name    = name;
+      for( const auto& signer : signers ) {
+         act.authorization.push_back( permission_level{ signer, config::active_name } );
+      }
+      act.data = reward_abi_ser.variant_to_binary( reward_abi_ser.get_action_type(name), data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+
+      signed_transaction trx;
+      trx.actions.push_back( std::move(act) );
+      set_transaction_headers(trx);
+      for( const auto& signer : signers ) {
+         trx.sign( get_private_key( signer, "active" ), control->get_chain_id() );
+      }
+      return push_transaction( trx );
+   }
+
+   // flon.system registers the producer for rewards as well
+   void reward_regproducer( const name& producer ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer( producer ) );
+   }
+
+   // flon.reward follows the votes through the notifications of flon.system
+   void reward_addvote( const name& voter, int64_t votes ) {
+      const asset vote_staked( votes, symbol{CORE_SYM} );
+      transfer( config::system_account_name, voter, vote_staked );
+      BOOST_REQUIRE_EQUAL( success(), addvote( voter, vote_staked ) );
+   }
+
+   void reward_voteproducer( const name& voter, const vector<name>& producers ) {
+      BOOST_REQUIRE_EQUAL( success(), vote( voter, producers ) );
+   }
+
+   transaction_trace_ptr reward_claimrewards( const name& voter ) {
+      return push_reward_action( { voter }, "claimrewards"_n, mvo()("voter", voter) );
+   }
+
+   void deposit_rewards( const name& producer, const asset& quantity ) {
+      transfer( producer, reward_account, quantity, producer );
+   }
+
+   fc::variant get_reward_voter( const name& voter ) {
+      vector<char> data = get_row_by_account( reward_account, reward_account, "voters"_n, voter );
+      return data.empty() ? fc::variant() : reward_abi_ser.binary_to_variant( "voter", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_reward_producer( const name& producer ) {
+      vector<char> data = get_row_by_account( reward_account, reward_account, "producers"_n, producer );
+      return data.empty() ? fc::variant() : reward_abi_ser.binary_to_variant( "producer", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   // Producer rows set `update_at` whenever they are written
+   std::map<name, string> get_producer_update_times( const vector<name>& producers ) {
+      std::map<name, string> times;
+      for( const auto& p : producers ) {
+         times[p] = get_reward_producer( p )["update_at"].as_string();
+      }
+      return times;
+   }
+
+   size_t count_producer_writes( const std::map<name, string>& update_times_before ) {
+      size_t writes = 0;
+      for( const auto& [p, update_at] : update_times_before ) {
+         if( get_reward_producer( p )["update_at"].as_string() != update_at ) {
+            ++writes;
+         }
+      }
+      return writes;
+   }
+
+   fc::variant get_basket( uint64_t id ) {
+      vector<char> data = get_row_by_id( reward_account, reward_account, "baskets"_n, id );
+      return data.empty() ? fc::variant() : reward_abi_ser.binary_to_variant( "basket", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   vector<name> setup_reward_producers( uint32_t count ) {
+      vector<name> producers;
+      for( uint32_t i = 0; i < count; ++i ) {
+         producers.emplace_back( std::string("rewardprod") + char('a' + i / 5) + char('1' + i % 5) );
+      }
+      create_accounts_with_resources( producers );
+      for( const auto& p : producers ) {
+         reward_regproducer( p );
+         transfer( config::system_account_name, p, core_sym::from_string("10000.0000") );
+      }
+      std::sort( producers.begin(), producers.end() );
+      return producers;
+   }
+};
+
+BOOST_AUTO_TEST_SUITE(flon_reward_tests)
+
+BOOST_FIXTURE_TEST_CASE( basket_shared_by_voters, flon_reward_tester ) try {
+   const auto producers = setup_reward_producers( 3 );
+   const vector<name> voted = { producers[0], producers[1] };
+
+   reward_addvote( "alice1111111"_n, 100'0000 );
+   reward_addvote( "bob111111111"_n, 300'0000 );
+   reward_voteproducer( "alice1111111"_n, voted );
+   reward_voteproducer( "bob111111111"_n, voted );
+
+   const auto alice = get_reward_voter( "alice1111111"_n );
+   const auto bob   = get_reward_voter( "bob111111111"_n );
+   const auto basket_id = alice["basket_id"].as_uint64();
+   BOOST_REQUIRE( basket_id != 0 );
+   BOOST_REQUIRE_EQUAL( basket_id, bob["basket_id"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 0u, alice["producers"].get_array().size() );
+
+   auto basket = get_basket( basket_id );
+   BOOST_REQUIRE_EQUAL( 2u, basket["voter_count"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 400'0000, basket["votes"].as_int64() );
+
+   deposit_rewards( producers[0], core_sym::from_string("40.0000") );
+   deposit_rewards( producers[1], core_sym::from_string("20.0000") );
+   deposit_rewards( producers[2], core_sym::from_string("10.0000") );
+
+   const auto alice_balance = get_balance( "alice1111111"_n );
+   reward_claimrewards( "alice1111111"_n );
+   BOOST_REQUIRE_EQUAL( alice_balance + core_sym::from_string("15.0000"), get_balance( "alice1111111"_n ) );
+
+   const auto bob_balance = get_balance( "bob111111111"_n );
+   reward_claimrewards( "bob111111111"_n );
+   BOOST_REQUIRE_EQUAL( bob_balance + core_sym::from_string("45.0000"), get_balance( "bob111111111"_n ) );
+
+   // moving to another producer set leaves the basket to its other voter
+   reward_voteproducer( "alice1111111"_n, { producers[2] } );
+   basket = get_basket( basket_id );
+   BOOST_REQUIRE_EQUAL( 1u, basket["voter_count"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 300'0000, basket["votes"].as_int64() );
+
+   // the last voter leaving erases the basket
+   reward_voteproducer( "bob111111111"_n, {} );
+   BOOST_REQUIRE( get_basket( basket_id ).is_null() );
+   BOOST_REQUIRE_EQUAL( 0u, get_reward_voter( "bob111111111"_n )["basket_id"].as_uint64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( claimrewards_cpu, flon_reward_tester ) try {
+   const auto producers = setup_reward_producers( 30 );
+   const uint32_t rounds = 10;
+
+   // Claims `rounds` times in turn for `voters`, after rewards are deposited to all the producers.
+   // Returns the average CPU of a claim.
+   const auto claim_cpu = [&]( const vector<name>& voters, const std::function<void(const transaction_trace&)>& check_trace ) {
+      int64_t total_cpu_us = 0;
+      for( uint32_t i = 0; i < rounds; ++i ) {
+         for( const auto& p : producers ) {
+            deposit_rewards( p, core_sym::from_string("1.0000") );
+         }
+         produce_block();
+
+         auto trace = reward_claimrewards( voters[i % voters.size()] );
+         BOOST_REQUIRE( trace->receipt.has_value() );
+         total_cpu_us += trace->elapsed.count();
+         check_trace( *trace );
+      }
+      return total_cpu_us / rounds;
+   };
+
+   // voters accounted per producer, as flon.reward did before vote baskets; with too few votes to
+   // open a basket they stay legacy voters when they claim
+   const vector<name> legacy_voters = { "legacyvotera"_n, "legacyvoterb"_n, "legacyvoterc"_n };
+   create_accounts_with_resources( legacy_voters );
+   set_code( reward_account, system_contracts::testing::test_contracts::legacy_reward_wasm() );
+   set_abi( reward_account, system_contracts::testing::test_contracts::legacy_reward_abi().data() );
+   for( const auto& v : legacy_voters ) {
+      reward_addvote( v, 5'0000 );
+      reward_voteproducer( v, producers );
+      base_tester::push_action( reward_account, "setvoter"_n, reward_account, mvo()
+         ("owner", v)("votes", 5'0000)("producers", producers)("core_symbol", symbol{CORE_SYM}) );
+   }
+   set_code( reward_account, contracts::reward_wasm() );
+   set_abi( reward_account, contracts::reward_abi().data() );
+   produce_block();
+
+   // a legacy claim settles the voter through each of its 30 producer rows
+   const auto legacy_cpu_us = claim_cpu( legacy_voters, []( const transaction_trace& ) {} );
+   for( const auto& v : legacy_voters ) {
+      BOOST_REQUIRE_EQUAL( producers.size(), get_reward_voter( v )["producers"].get_array().size() );
+   }
+
+   const vector<name> voters = { "alice1111111"_n, "bob111111111"_n, "carol1111111"_n };
+   for( const auto& v : voters ) {
+      reward_addvote( v, 100'0000 );
+      reward_voteproducer( v, producers );
+   }
+   BOOST_REQUIRE_EQUAL( voters.size(), get_basket( get_reward_voter( voters[0] )["basket_id"].as_uint64() )["voter_count"].as_uint64() );
+
+   // A basket claim touches the voter and its basket only, the 30 producer rows are read but never written.
+   const auto basket_cpu_us = claim_cpu( voters, [&]( const transaction_trace& trace ) {
+      for( const auto& a : trace.action_traces ) {
+         if( a.receiver == reward_account ) {
+            for( const auto& delta : a.account_ram_deltas ) {
+               BOOST_REQUIRE( delta.account != reward_account || delta.delta <= 0 );
+            }
+         }
+      }
+   });
+   BOOST_TEST_MESSAGE( "claimrewards of a legacy voter of 30 producers: " << legacy_cpu_us << " us per claim" );
+   BOOST_TEST_MESSAGE( "claimrewards with a 30 producer basket: " << basket_cpu_us << " us per claim" );
+
+   // the varint encoded producer accumulators of the basket need far less than 16 bytes each
+   const auto basket = get_basket( get_reward_voter( voters[0] )["basket_id"].as_uint64() );
+   BOOST_REQUIRE( basket["last_rewards_per_vote"].as<vector<char>>().size() <= 9 * producers.size() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( vote_change_row_writes, flon_reward_tester ) try {
+   const auto producers = setup_reward_producers( 5 );
+   const auto alice = "alice1111111"_n;
+
+   reward_addvote( alice, 100'0000 );
+   reward_voteproducer( alice, { producers[0], producers[1], producers[2], producers[3] } );
+   produce_block();
+
+   // flon.reward reads the producer votes from flon.system, a vote change writes none of its producer rows
+   auto update_times = get_producer_update_times( producers );
+   reward_voteproducer( alice, { producers[0], producers[1], producers[2], producers[4] } );
+   BOOST_REQUIRE_EQUAL( 0u, count_producer_writes( update_times ) );
+   BOOST_REQUIRE_EQUAL( 0,        get_producer_info( producers[3] )["total_votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 100'0000, get_producer_info( producers[4] )["total_votes"].as_int64() );
+   produce_block();
+
+   // a claim writes the basket but none of its producers
+   deposit_rewards( producers[0], core_sym::from_string("10.0000") );
+   produce_block();
+   update_times = get_producer_update_times( producers );
+   const auto basket_id = get_reward_voter( alice )["basket_id"].as_uint64();
+   const auto basket_update_at = get_basket( basket_id )["update_at"].as_string();
+   reward_claimrewards( alice );
+   BOOST_REQUIRE_EQUAL( 0u, count_producer_writes( update_times ) );
+   BOOST_REQUIRE( basket_update_at != get_basket( basket_id )["update_at"].as_string() );
+   produce_block();
+
+   // a stake change only writes the voter and its basket
+   update_times = get_producer_update_times( producers );
+   reward_addvote( alice, 10'0000 );
+   BOOST_REQUIRE_EQUAL( 0u, count_producer_writes( update_times ) );
+   BOOST_REQUIRE_EQUAL( 110'0000, get_basket( basket_id )["votes"].as_int64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( legacy_voter_migration, flon_reward_tester ) try {
+   const auto producers = setup_reward_producers( 2 );
+   const auto alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+
+   // voters accounted per producer, as flon.reward did before vote baskets
+   set_code( reward_account, system_contracts::testing::test_contracts::legacy_reward_wasm() );
+   set_abi( reward_account, system_contracts::testing::test_contracts::legacy_reward_abi().data() );
+   const auto set_legacy_voter = [&]( const name& voter, int64_t votes, const vector<name>& voted ) {
+      reward_addvote( voter, votes );
+      reward_voteproducer( voter, voted );
+      base_tester::push_action( reward_account, "setvoter"_n, reward_account, mvo()
+         ("owner", voter)("votes", votes)("producers", voted)("core_symbol", symbol{CORE_SYM}) );
+   };
+   set_legacy_voter( alice, 100'0000, producers );
+   set_legacy_voter( bob,   300'0000, { producers[0] } );
+   set_legacy_voter( carol,   5'0000, { producers[1] } );
+   set_code( reward_account, contracts::reward_wasm() );
+   set_abi( reward_account, contracts::reward_abi().data() );
+   produce_block();
+
+   // 400 votes for producers[0]: alice 10.0000, bob 30.0000; 105 votes for producers[1]: alice 20.0000, carol 1.0000
+   deposit_rewards( producers[0], core_sym::from_string("40.0000") );
+   deposit_rewards( producers[1], core_sym::from_string("21.0000") );
+
+   // anyone can migrate legacy voters, their rewards are settled before they join a basket
+   push_reward_action( { bob }, "migratevoter"_n, mvo()("voters", vector<name>{ alice, carol }) );
+   auto voter = get_reward_voter( alice );
+   BOOST_REQUIRE_EQUAL( 0u, voter["producers"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), voter["unclaimed_rewards"].as<asset>() );
+   const auto basket = get_basket( voter["basket_id"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 100'0000, basket["votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 1u, basket["voter_count"].as_uint64() );
+
+   // too few votes to open a basket, carol stays a legacy voter
+   voter = get_reward_voter( carol );
+   BOOST_REQUIRE( !voter.get_object().contains( "basket_id" ) );
+   BOOST_REQUIRE_EQUAL( 1u, voter["producers"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"), voter["unclaimed_rewards"].as<asset>() );
+
+   // claiming migrates bob
+   const auto claim = [&]( const name& voter ) {
+      const auto balance = get_balance( voter );
+      reward_claimrewards( voter );
+      return get_balance( voter ) - balance;
+   };
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), claim( alice ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), claim( bob ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"),  claim( carol ) );
+   BOOST_REQUIRE( get_reward_voter( bob )["basket_id"].as_uint64() != 0 );
+
+   // basket and legacy voters of the same producer keep their shares
+   deposit_rewards( producers[1], core_sym::from_string("21.0000") );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), claim( alice ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"),  claim( carol ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( small_voters_share_baskets, flon_reward_tester ) try {
+   const auto producers = setup_reward_producers( 2 );
+   const auto alice = "alice1111111"_n, bob = "bob111111111"_n, carol = "carol1111111"_n;
+
+   // a voter below MIN_BASKET_VOTES can not open a basket, which flon.reward pays for
+   reward_addvote( alice, 5'0000 );
+   reward_voteproducer( alice, { producers[0] } );
+   auto voter = get_reward_voter( alice );
+   BOOST_REQUIRE( !voter.get_object().contains( "basket_id" ) );
+   BOOST_REQUIRE_EQUAL( 1u, voter["producers"].get_array().size() );
+
+   // but it joins a basket opened by another voter
+   reward_addvote( bob, 10'0000 );
+   reward_voteproducer( bob, { producers[0] } );
+   const auto basket_id = get_reward_voter( bob )["basket_id"].as_uint64();
+   BOOST_REQUIRE( basket_id != 0 );
+   reward_addvote( carol, 5'0000 );
+   reward_voteproducer( carol, { producers[0] } );
+   BOOST_REQUIRE_EQUAL( basket_id, get_reward_voter( carol )["basket_id"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 15'0000, get_basket( basket_id )["votes"].as_int64() );
+
+   // 20 votes for producers[0]: alice 1.0000, bob 2.0000, carol 1.0000
+   deposit_rewards( producers[0], core_sym::from_string("4.0000") );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"), read_only_action( "getvoter"_n, mvo()("voter", alice) )["unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("2.0000"), read_only_action( "getvoter"_n, mvo()("voter", bob) )["unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1.0000"), read_only_action( "getvoter"_n, mvo()("voter", carol) )["unclaimed_rewards"].as<asset>() );
+
+   // the next touch of alice moves it into the basket
+   push_reward_action( { bob }, "migratevoter"_n, mvo()("voters", vector<name>{ alice }) );
+   BOOST_REQUIRE_EQUAL( basket_id, get_reward_voter( alice )["basket_id"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 20'0000, get_basket( basket_id )["votes"].as_int64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( voter_row_lifetime, flon_reward_tester ) try {
+   cross_15_percent_threshold();
+   const auto producers = setup_reward_producers( 2 );
+   const auto alice = "alice1111111"_n, bob = "bob111111111"_n;
+   const auto below_min = wasm_assert_msg( "[[100]] [[flon]] voter votes can not be less than min_voter_votes" );
+
+   // a voter holds none or at least 1.0000 votes, which bounds the voter rows paid by flon.reward
+   transfer( config::system_account_name, alice, core_sym::from_string("200.0000") );
+   BOOST_REQUIRE_EQUAL( below_min, addvote( alice, core_sym::from_string("0.9999") ) );
+   BOOST_REQUIRE( get_reward_voter( alice ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), addvote( alice, core_sym::from_string("100.0000") ) );
+   reward_voteproducer( alice, { producers[0] } );
+   BOOST_REQUIRE_EQUAL( below_min, subvote( alice, core_sym::from_string("99.5000") ) );
+
+   // subtracting all votes keeps the row only for its unclaimed rewards
+   deposit_rewards( producers[0], core_sym::from_string("10.0000") );
+   const auto basket_id = get_reward_voter( alice )["basket_id"].as_uint64();
+   BOOST_REQUIRE_EQUAL( success(), subvote( alice, core_sym::from_string("100.0000") ) );
+   BOOST_REQUIRE( get_basket( basket_id ).is_null() );
+   auto voter = get_reward_voter( alice );
+   BOOST_REQUIRE_EQUAL( 0, voter["votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), voter["unclaimed_rewards"].as<asset>() );
+   const auto alice_balance = get_balance( alice );
+   reward_claimrewards( alice );
+   BOOST_REQUIRE_EQUAL( alice_balance + core_sym::from_string("10.0000"), get_balance( alice ) );
+   BOOST_REQUIRE( get_reward_voter( alice ).is_null() );
+
+   // a voter without rewards loses its row with its last votes
+   reward_addvote( bob, 50'0000 );
+   BOOST_REQUIRE( !get_reward_voter( bob ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), subvote( bob, core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE( get_reward_voter( bob ).is_null() );
+
+   // voting again joins the basket of the producers still voted in flon.system
+   BOOST_REQUIRE_EQUAL( success(), addvote( alice, core_sym::from_string("20.0000") ) );
+   voter = get_reward_voter( alice );
+   BOOST_REQUIRE_EQUAL( 20'0000, voter["votes"].as_int64() );
+   const auto basket = get_basket( voter["basket_id"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 20'0000, basket["votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( producers[0], basket["producers"].get_array()[0].as<name>() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( rewards_paid_by_transfers, flon_reward_tester ) try {
+   const auto producers = setup_reward_producers( 1 );
+   reward_addvote( "alice1111111"_n, 100'0000 );
+   reward_voteproducer( "alice1111111"_n, producers );
+
+   // the item to flon.reward in a transfers batch is accounted as a transfer would be
+   base_tester::push_action( "flon.token"_n, "transfers"_n, producers[0], mvo()
+      ("from",      producers[0])
+      ("transfers", vector<fc::variant>{
+         mvo()("to", reward_account)("quantity", core_sym::from_string("30.0000"))("memo", producers[0].to_string()),
+         mvo()("to", "bob111111111")("quantity", core_sym::from_string("5.0000"))("memo", "") }) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), get_reward_producer( producers[0] )["total_rewards"].as<asset>() );
+
+   const auto alice_balance = get_balance( "alice1111111"_n );
+   reward_claimrewards( "alice1111111"_n );
+   BOOST_REQUIRE_EQUAL( alice_balance + core_sym::from_string("30.0000"), get_balance( "alice1111111"_n ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
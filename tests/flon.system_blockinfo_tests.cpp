@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <limits>
 
@@ -93,15 +94,28 @@ public:
 
       const auto& idx = control->db().get_index<eosio::chain::key_value_index, eosio::chain::by_scope_primary>();
 
-      unsigned int rows_visited = 0;
-
-      block_info_record r;
+      // Rows are keyed by their slot in the ring buffer rather than by block height, so collect the matching rows
+      // first and sort them by block height before visiting.
+      std::vector<block_info_record> rows;
 
-      for (auto itr = idx.lower_bound(boost::make_tuple(*t_id, static_cast<uint64_t>(start_block_height)));
-           itr != idx.end() && itr->t_id == *t_id && itr->primary_key <= end_block_height; ++itr) //
+      for (auto itr = idx.lower_bound(boost::make_tuple(*t_id, uint64_t{0})); itr != idx.end() && itr->t_id == *t_id;
+           ++itr) //
       {
+         block_info_record r;
          fc::datastream<const char*> ds(itr->value.data(), itr->value.size());
          fc::raw::unpack(ds, r);
+         if (start_block_height <= r.block_height && r.block_height <= end_block_height) {
+            rows.push_back(std::move(r));
+         }
+      }
+
+      std::sort(rows.begin(), rows.end(), [](const block_info_record& lhs, const block_info_record& rhs) {
+         return lhs.block_height < rhs.block_height;
+      });
+
+      unsigned int rows_visited = 0;
+
+      for (auto& r : rows) {
          ++rows_visited;
          if (!visitor(std::move(r))) {
             break;
@@ -2,6 +2,7 @@
 
 #include "contracts.hpp"
 #include "test_symbol.hpp"
+#include "read_only_action.hpp"
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/testing/tester.hpp>
@@ -936,6 +937,10 @@ public:
       return get_producer_info( account_name(act) );
    }
 
+   fc::variant read_only_action( const action_name& name, const variant_object& data ) {
+      return eosio::testing::read_only_action( *this, config::system_account_name, abi_ser, name, data );
+   }
+
    void create_currency( name contract, name manager, asset maxsupply ) {
       auto act =  mutable_variant_object()
          ("issuer",       manager )
@@ -1047,6 +1052,21 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
    }
 
+   fc::variant get_elected_producers_info() {
+      vector<char> data = get_row_by_id( config::system_account_name, config::system_account_name, "electedprods"_n, 0 );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "elected_producers_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_global_state2() {
+      vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "global2"_n, "global2"_n );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state2", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_production_round_info() {
+      vector<char> data = get_row_by_id( config::system_account_name, config::system_account_name, "prodround"_n, 0 );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "production_round_info", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
    fc::variant get_global_state3() {
       vector<char> data = get_row_by_account( config::system_account_name, config::system_account_name, "global3"_n, "global3"_n );
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "eosio_global_state3", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
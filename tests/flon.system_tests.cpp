@@ -10,6 +10,12 @@
 #include <eosio/chain/exceptions.hpp>
 
 #include "flon.system_tester.hpp"
+#include "../contracts/flon.system/include/flon.system/schedule_order.hpp"
+
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <set>
 struct _abi_hash {
    name owner;
    fc::sha256 hash;
@@ -1607,6 +1613,395 @@ BOOST_FIXTURE_TEST_CASE( elect_producers /*_and_parameters*/, eosio_system_teste
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( elected_producers_cache, eosio_system_tester ) try {
+   create_accounts_with_resources( {  "defproducer1"_n, "defproducer2"_n, "defproducer3"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer1"_n, 1) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer2"_n, 2) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer3"_n, 3) );
+
+   transfer( "flon", "alice1111111", core_sym::from_string("600000000.0000"), "flon" );
+   BOOST_REQUIRE_EQUAL( success(), addvote( "alice1111111", "alice1111111", core_sym::from_string("300000000.0000"), core_sym::from_string("300000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+   produce_blocks(250);
+
+   auto elected = get_elected_producers_info();
+   BOOST_REQUIRE( !elected.is_null() );
+   BOOST_REQUIRE_EQUAL( elected["vote_generation"].as_uint64(), elected["elected_generation"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 2u, elected["elected_producers"].get_array().size() );
+   const auto generation = elected["vote_generation"].as_uint64();
+
+   // more votes for elected producers can not change the elected set
+   issue_and_transfer( "bob111111111", core_sym::from_string("80000.0000"),  config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), addvote( "bob111111111", core_sym::from_string("40000.0000"), core_sym::from_string("40000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, { "defproducer1"_n } ) );
+   produce_blocks(250);
+   elected = get_elected_producers_info();
+   BOOST_REQUIRE_EQUAL( generation, elected["vote_generation"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( generation, elected["elected_generation"].as_uint64() );
+
+   // a new candidate with votes makes the elected set dirty until the next schedule update
+   BOOST_REQUIRE_EQUAL( success(), vote( "bob111111111"_n, { "defproducer1"_n, "defproducer3"_n } ) );
+   elected = get_elected_producers_info();
+   BOOST_REQUIRE_EQUAL( generation + 1, elected["vote_generation"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( generation, elected["elected_generation"].as_uint64() );
+
+   produce_blocks(250);
+   elected = get_elected_producers_info();
+   BOOST_REQUIRE_EQUAL( generation + 1, elected["elected_generation"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( 3u, elected["elected_producers"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( 3u, control->active_producers().producers.size() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( voteproducer_swap_one, eosio_system_tester ) try {
+   create_accounts_with_resources( {  "defproducer1"_n, "defproducer2"_n, "defproducer3"_n, "defproducer4"_n } );
+   for( const auto& p : { "defproducer1"_n, "defproducer2"_n, "defproducer3"_n, "defproducer4"_n } ) {
+      BOOST_REQUIRE_EQUAL( success(), regproducer( p ) );
+   }
+
+   transfer( "flon", "alice1111111", core_sym::from_string("2000.0000"), "flon" );
+   BOOST_REQUIRE_EQUAL( success(), addvote( "alice1111111", "alice1111111", core_sym::from_string("500.0000"), core_sym::from_string("500.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n, "defproducer3"_n } ) );
+   const auto votes = get_voter_info( "alice1111111" )["votes"].as_int64();
+   BOOST_REQUIRE( votes > 0 );
+
+   // only the removed and the added producer rows are written, the undo session of the pending block records every write
+   base_tester::push_action( config::system_account_name, "voteproducer"_n, "alice1111111"_n, mvo()
+                             ("voter",     "alice1111111")
+                             ("producers", vector<name>{ "defproducer1"_n, "defproducer2"_n, "defproducer4"_n }) );
+   std::set<name> written;
+   const auto& db = control->db();
+   for( const auto& row : control->mutable_db().get_mutable_index<eosio::chain::key_value_index>().last_undo_session().old_values ) {
+      const auto& table = db.get<eosio::chain::table_id_object>( row.t_id );
+      if( table.code == config::system_account_name && table.table == "producers"_n ) {
+         written.insert( name( row.primary_key ) );
+      }
+   }
+   BOOST_REQUIRE( (std::set<name>{ "defproducer3"_n, "defproducer4"_n }) == written );
+
+   BOOST_REQUIRE_EQUAL( votes, get_producer_info( "defproducer1" )["total_votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( votes, get_producer_info( "defproducer2" )["total_votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 0,     get_producer_info( "defproducer3" )["total_votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( votes, get_producer_info( "defproducer4" )["total_votes"].as_int64() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( production_round_settlement, eosio_system_tester ) try {
+   create_accounts_with_resources( {  "defproducer1"_n, "defproducer2"_n } );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer1"_n, 1) );
+   BOOST_REQUIRE_EQUAL( success(), regproducer( "defproducer2"_n, 2) );
+
+   transfer( "flon", "alice1111111", core_sym::from_string("600000000.0000"), "flon" );
+   BOOST_REQUIRE_EQUAL( success(), addvote( "alice1111111", "alice1111111", core_sym::from_string("300000000.0000"), core_sym::from_string("300000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, { "defproducer1"_n, "defproducer2"_n } ) );
+   BOOST_REQUIRE_EQUAL( success(), cfgelection() );
+   produce_blocks(250);
+   BOOST_REQUIRE_EQUAL( 2u, control->active_producers().producers.size() );
+   produce_blocks(500);
+
+   const auto round = get_production_round_info();
+   BOOST_REQUIRE( !round.is_null() );
+   BOOST_REQUIRE_EQUAL( 0, round["reward_period"].as_int64() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.8000").get_amount(), round["rewards_per_block"].as_int64() );
+
+   // every settled block is paid to its producer, the unsettled ones are still counted in the round
+   int64_t unsettled_blocks = 0;
+   for( const auto& b : round["produced_blocks"].get_array() ) {
+      unsettled_blocks += b["blocks"].as_int64();
+   }
+   BOOST_REQUIRE( unsettled_blocks <= 121 );
+
+   const auto gstate2 = get_global_state2();
+   const auto total_produced_rewards = gstate2["total_produced_rewards"].as<asset>();
+   BOOST_REQUIRE( total_produced_rewards.get_amount() > 0 );
+   BOOST_REQUIRE_EQUAL( total_produced_rewards, gstate2["total_unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( total_produced_rewards,
+                        get_producer_info( "defproducer1"_n )["unclaimed_rewards"].as<asset>() +
+                        get_producer_info( "defproducer2"_n )["unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 0, total_produced_rewards.get_amount() % core_sym::from_string("0.8000").get_amount() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( global2_migration, eosio_system_tester ) try {
+   // election and reward state kept in `global`, as before `global2` existed
+   const auto now = control->head_block_time();
+   const auto election_activated_time = now + fc::days(1);
+   const auto reward_started_time = now + fc::days(2);
+   const auto last_producer_schedule_update = block_timestamp_type( now - fc::minutes(1) );
+   const auto last_name_close = block_timestamp_type( now - fc::hours(1) );
+   set_code( config::system_account_name, system_contracts::testing::test_contracts::legacy_global_wasm() );
+   set_abi( config::system_account_name, system_contracts::testing::test_contracts::legacy_global_abi().data() );
+   base_tester::push_action( config::system_account_name, "setglobal"_n, config::system_account_name, mvo()
+      ("total_vote_stake",              core_sym::from_string("1234.0000"))
+      ("election_activated_time",       election_activated_time)
+      ("reward_started_time",           reward_started_time)
+      ("initial_rewards_per_block",     core_sym::from_string("0.8000"))
+      ("total_produced_rewards",        core_sym::from_string("56.0000"))
+      ("total_unclaimed_rewards",       core_sym::from_string("7.0000"))
+      ("last_producer_schedule_size",   21)
+      ("last_producer_schedule_update", last_producer_schedule_update)
+      ("last_name_close",               last_name_close) );
+   set_code( config::system_account_name, contracts::system_wasm() );
+   set_abi( config::system_account_name, contracts::system_abi().data() );
+   BOOST_REQUIRE( get_global_state2().is_null() );
+
+   // the first onblock moves them to `global2` and zeroes them in `global`
+   produce_block();
+   auto gstate2 = get_global_state2();
+   BOOST_REQUIRE( !gstate2.is_null() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1234.0000"), gstate2["total_vote_stake"].as<asset>() );
+   BOOST_REQUIRE( election_activated_time == gstate2["election_activated_time"].as<time_point>() );
+   BOOST_REQUIRE( reward_started_time == gstate2["reward_started_time"].as<time_point>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.8000"), gstate2["initial_rewards_per_block"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("56.0000"), gstate2["total_produced_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("7.0000"), gstate2["total_unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 21u, gstate2["last_producer_schedule_size"].as_uint64() );
+   BOOST_REQUIRE( last_producer_schedule_update == gstate2["last_producer_schedule_update"].as<block_timestamp_type>() );
+   BOOST_REQUIRE( last_name_close == gstate2["last_name_close"].as<block_timestamp_type>() );
+
+   const auto gstate = get_global_state();
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), gstate["total_vote_stake"].as<asset>() );
+   BOOST_REQUIRE( time_point() == gstate["election_activated_time"].as<time_point>() );
+   BOOST_REQUIRE( time_point() == gstate["reward_started_time"].as<time_point>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), gstate["total_produced_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), gstate["total_unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 0u, gstate["last_producer_schedule_size"].as_uint64() );
+
+   // later actions update `global2` only
+   transfer( "flon", "alice1111111", core_sym::from_string("200.0000"), "flon" );
+   BOOST_REQUIRE_EQUAL( success(), addvote( "alice1111111", "alice1111111", core_sym::from_string("50.0000"), core_sym::from_string("50.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("1334.0000"), get_global_state2()["total_vote_stake"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), get_global_state()["total_vote_stake"].as<asset>() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( schedule_ordered_by_latency, eosio_system_tester ) try {
+   const vector<name> producers = { "defproducera"_n, "defproducerb"_n, "defproducerc"_n,
+                                    "defproducerd"_n, "defproducere"_n, "defproducerf"_n };
+   const vector<uint16_t> locations = { 1, 2, 1, 3, 2, 3 };
+   create_accounts_with_resources( producers );
+   for( size_t i = 0; i < producers.size(); ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), push_action( producers[i], "regproducer"_n, mvo()
+                                                   ("producer",            producers[i])
+                                                   ("producer_key",        get_public_key( producers[i], "active" ))
+                                                   ("url",                 "")
+                                                   ("location",            locations[i])
+                                                   ("reward_shared_ratio", 0) ) );
+   }
+
+   transfer( "flon", "alice1111111", core_sym::from_string("600000000.0000"), "flon" );
+   BOOST_REQUIRE_EQUAL( success(), addvote( "alice1111111", "alice1111111", core_sym::from_string("300000000.0000"), core_sym::from_string("300000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( "alice1111111"_n, producers ) );
+   produce_blocks(250);
+
+   auto schedule_names = [&]() {
+      vector<name> names;
+      for( const auto& p : control->active_producers().producers ) {
+         names.push_back( p.producer_name );
+      }
+      return names;
+   };
+
+   // without published latencies the producers of a location are grouped together
+   BOOST_REQUIRE( (vector<name>{ "defproducera"_n, "defproducerc"_n, "defproducerb"_n,
+                                 "defproducere"_n, "defproducerd"_n, "defproducerf"_n }) == schedule_names() );
+   BOOST_REQUIRE_EQUAL( producers.size(), get_elected_producers_info()["elected_producers"].get_array().size() );
+
+   // location 2 sits between 1 and 3, the schedule visits it on the way out and on the way back
+   auto setlatency = [&]( uint16_t a, uint16_t b, uint32_t latency_ms ) {
+      return push_action( config::system_account_name, "setlatency"_n, mvo()
+                          ("location_a", a)
+                          ("location_b", b)
+                          ("latency_ms", latency_ms) );
+   };
+   BOOST_REQUIRE_EQUAL( success(), setlatency( 2, 1, 50 ) );
+   BOOST_REQUIRE_EQUAL( success(), setlatency( 2, 3, 50 ) );
+   BOOST_REQUIRE_EQUAL( success(), setlatency( 1, 3, 300 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "[[5]] [[flon]] locations must be different" ), setlatency( 3, 3, 10 ) );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of flon" ),
+                        push_action( "alice1111111"_n, "setlatency"_n, mvo()("location_a", 1)("location_b", 4)("latency_ms", 10) ) );
+   produce_blocks(250);
+   BOOST_REQUIRE( (vector<name>{ "defproducera"_n, "defproducerc"_n, "defproducerb"_n,
+                                 "defproducerf"_n, "defproducerd"_n, "defproducere"_n }) == schedule_names() );
+
+   // the elected set itself stays sorted by name
+   const auto elected = get_elected_producers_info()["elected_producers"].as<vector<name>>();
+   BOOST_REQUIRE( producers == elected );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( schedule_order_cpu ) try {
+   std::mt19937 rng( 21 );
+   const uint32_t producer_count = 21, rounds = 1000;
+
+   // synthetic locations on a 200 x 100 ms plane, latency is the distance between them
+   std::vector<std::pair<int, int>> position( producer_count );
+   for( auto& p : position ) {
+      p = { int(rng() % 200), int(rng() % 100) };
+   }
+   std::vector<std::vector<uint32_t>> latency( producer_count, std::vector<uint32_t>( producer_count ) );
+   for( uint32_t i = 0; i < producer_count; ++i ) {
+      for( uint32_t j = 0; j < producer_count; ++j ) {
+         latency[i][j] = uint32_t( std::hypot( position[i].first - position[j].first, position[i].second - position[j].second ) );
+      }
+   }
+   auto total_latency = [&]( const std::vector<uint32_t>& order ) {
+      uint64_t total = 0;
+      for( uint32_t i = 0; i < order.size(); ++i ) {
+         total += latency[order[i]][order[(i + 1) % order.size()]];
+      }
+      return total;
+   };
+
+   std::vector<uint32_t> by_name( producer_count );
+   std::iota( by_name.begin(), by_name.end(), 0 );
+   const auto greedy = eosiosystem::order_by_latency( latency, 0 );
+   const auto order = eosiosystem::order_by_latency( latency );
+
+   auto sorted = order;
+   std::sort( sorted.begin(), sorted.end() );
+   BOOST_REQUIRE( sorted == by_name );
+   BOOST_REQUIRE_EQUAL( 0u, order[0] );
+   BOOST_REQUIRE( order == eosiosystem::order_by_latency( latency ) );
+   BOOST_REQUIRE( total_latency( greedy ) < total_latency( by_name ) );
+   BOOST_REQUIRE( total_latency( order ) < total_latency( greedy ) );
+
+   uint64_t checksum = 0;
+   auto start = fc::time_point::now();
+   for( uint32_t n = 0; n < rounds; ++n ) {
+      checksum += eosiosystem::order_by_latency( latency )[n % producer_count];
+   }
+   const auto elapsed_us = (fc::time_point::now() - start).count();
+   BOOST_REQUIRE( checksum > 0 );
+   BOOST_TEST_MESSAGE( "schedule order of " << producer_count << " producers: by name " << total_latency( by_name )
+                       << " ms, greedy " << total_latency( greedy ) << " ms, 2-opt " << total_latency( order )
+                       << " ms, " << double(elapsed_us) / rounds << " us per order" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( vote_refund_tranches, eosio_system_tester ) try {
+   cross_15_percent_threshold();
+   const name carol = "carol1111111"_n;
+   const auto not_matured = wasm_assert_msg( "[[101]] [[flon]] no matured vote refund found" );
+   issue_and_transfer( carol, core_sym::from_string("100.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), addvote( carol, core_sym::from_string("60.0000") ) );
+
+   // several refunds mature independently, without any deferred transaction
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("10.0000") ) );
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("20.0000") ) );
+   BOOST_REQUIRE_EQUAL( not_matured, voterefund( carol ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("40.0000"), get_balance( carol ) );
+
+   // the next addvote settles the matured tranche
+   produce_block( fc::days(2) );
+   BOOST_REQUIRE_EQUAL( success(), addvote( carol, core_sym::from_string("5.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("45.0000"), get_balance( carol ) );
+   BOOST_REQUIRE_EQUAL( not_matured, voterefund( carol ) );
+
+   // anyone can sweep matured tranches
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "bob111111111"_n, "refundsweep"_n, mvo()("max_count", 10) ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("65.0000"), get_balance( carol ) );
+   BOOST_REQUIRE_EQUAL( not_matured, push_action( "bob111111111"_n, "refundsweep"_n, mvo()("max_count", 10) ) );
+
+   // the number of pending tranches of a voter is bounded
+   for( uint32_t i = 0; i < 16; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("1.0000") ) );
+   }
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "[[101]] [[flon]] too many pending vote refunds" ),
+                        subvote( carol, core_sym::from_string("1.0000") ) );
+   produce_block( fc::days(3) );
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("81.0000"), get_balance( carol ) );
+
+   // a sweep pays the consecutive tranches of a voter in one transfer
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("1.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("1.0000") ) );
+   produce_block( fc::days(3) );
+   auto trace = base_tester::push_action( config::system_account_name, "refundsweep"_n, "bob111111111"_n, mvo()("max_count", 10) );
+   BOOST_REQUIRE_EQUAL( 1, std::count_if( trace->action_traces.begin(), trace->action_traces.end(), [&]( const auto& a ) {
+      return a.receiver == "flon.token"_n && a.act.name == "transfer"_n;
+   }) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("84.0000"), get_balance( carol ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( election_queries, eosio_system_tester ) try {
+   const name alice = "alice1111111"_n, carol = "carol1111111"_n;
+   const vector<name> producers = { "defproducera"_n, "defproducerb"_n, "defproducerc"_n };
+   create_accounts_with_resources( producers );
+   for( const auto& p : producers ) {
+      regproducer( p );
+   }
+   transfer( "flon", "alice1111111", core_sym::from_string("300000000.0000"), "flon" );
+   issue_and_transfer( carol, core_sym::from_string("100.0000"), config::system_account_name );
+   BOOST_REQUIRE_EQUAL( success(), addvote( alice, core_sym::from_string("300000000.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), addvote( carol, core_sym::from_string("60.0000") ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( alice, { "defproducera"_n, "defproducerb"_n } ) );
+   BOOST_REQUIRE_EQUAL( success(), vote( carol, { "defproducerb"_n } ) );
+   produce_blocks(250);
+
+   // the active producers, most voted first
+   auto top = read_only_action( "getproducers"_n, mvo()("limit", 2) ).get_array();
+   BOOST_REQUIRE_EQUAL( 2u, top.size() );
+   BOOST_REQUIRE_EQUAL( "defproducerb", top[0]["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( 3000000600000, top[0]["total_votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( "defproducera", top[1]["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( 3000000000000, top[1]["total_votes"].as_int64() );
+   for( const auto& p : top ) {
+      BOOST_REQUIRE_EQUAL( true, p["is_elected"].as_bool() );
+      BOOST_REQUIRE_EQUAL( false, p["is_finalizer"].as_bool() );
+   }
+   BOOST_REQUIRE_EQUAL( 3u, read_only_action( "getproducers"_n, mvo()("limit", 10) ).get_array().size() );
+   BOOST_REQUIRE_EXCEPTION( read_only_action( "getproducers"_n, mvo()("limit", 0) ),
+                            eosio_assert_message_exception, eosio_assert_message_is( "[[5]] [[flon]] limit must be positive" ) );
+
+   // unclaimed rewards are computed from rewards_per_vote before flon.reward settles them
+   transfer( "flon", "defproducera", core_sym::from_string("30.0000"), "flon" );
+   transfer( "defproducera"_n, "flon.reward"_n, core_sym::from_string("30.0000"), "defproducera"_n );
+   auto state = read_only_action( "getvoter"_n, mvo()("voter", alice) );
+   BOOST_REQUIRE_EQUAL( "alice1111111", state["owner"].as_string() );
+   BOOST_REQUIRE_EQUAL( 3000000000000, state["votes"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 2u, state["producers"].get_array().size() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), state["unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), state["claimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( 0u, state["refunds"].get_array().size() );
+
+   const asset alice_balance = get_balance( alice );
+   base_tester::push_action( "flon.reward"_n, "claimrewards"_n, alice, mvo()("voter", alice) );
+   BOOST_REQUIRE_EQUAL( alice_balance + core_sym::from_string("30.0000"), get_balance( alice ) );
+   state = read_only_action( "getvoter"_n, mvo()("voter", alice) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"), state["unclaimed_rewards"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("30.0000"), state["claimed_rewards"].as<asset>() );
+
+   // an uneven split: getvoter reports exactly what claimrewards then pays
+   transfer( "flon", "defproducerb", core_sym::from_string("7.0001"), "flon" );
+   transfer( "defproducerb"_n, "flon.reward"_n, core_sym::from_string("7.0001"), "defproducerb"_n );
+   const asset unclaimed = read_only_action( "getvoter"_n, mvo()("voter", alice) )["unclaimed_rewards"].as<asset>();
+   BOOST_REQUIRE( unclaimed > core_sym::from_string("0.0000") );
+   const asset before_claim = get_balance( alice );
+   base_tester::push_action( "flon.reward"_n, "claimrewards"_n, alice, mvo()("voter", alice) );
+   BOOST_REQUIRE_EQUAL( before_claim + unclaimed, get_balance( alice ) );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("0.0000"),
+                        read_only_action( "getvoter"_n, mvo()("voter", alice) )["unclaimed_rewards"].as<asset>() );
+
+   // pending refunds, oldest first
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("10.0000") ) );
+   produce_block( fc::days(1) );
+   BOOST_REQUIRE_EQUAL( success(), subvote( carol, core_sym::from_string("20.0000") ) );
+   produce_block( fc::days(2) );
+   auto refunds = read_only_action( "getvoter"_n, mvo()("voter", carol) )["refunds"].get_array();
+   BOOST_REQUIRE_EQUAL( 2u, refunds.size() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("10.0000"), refunds[0]["vote_staked"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( true, refunds[0]["is_matured"].as_bool() );
+   BOOST_REQUIRE_EQUAL( core_sym::from_string("20.0000"), refunds[1]["vote_staked"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( false, refunds[1]["is_matured"].as_bool() );
+
+   BOOST_REQUIRE_EXCEPTION( read_only_action( "getvoter"_n, mvo()("voter", "bob111111111") ),
+                            eosio_assert_message_exception, eosio_assert_message_is( "[[1]] [[flon]] voter not found" ) );
+
+} FC_LOG_AND_RETHROW()
+
 
 BOOST_AUTO_TEST_SUITE_END()
 BOOST_AUTO_TEST_SUITE(eosio_system_name_tests)
@@ -2365,4 +2760,93 @@ BOOST_FIXTURE_TEST_CASE( buy_pin_sell_ram, eosio_system_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( batch_buy_gas, eosio_system_tester ) try {
+   create_accounts( { "flon.gas"_n } );
+   transfer( "flon", "alice1111111", core_sym::from_string("100.0000"), "flon" );
+   auto purchase = []( const string& receiver, const string& quant ) {
+      return mvo()("receiver", receiver)("quant", core_sym::from_string(quant));
+   };
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "purchases cannot be empty" ),
+                        push_action( "alice1111111"_n, "batchbuygas"_n, mvo()
+                                     ("payer", "alice1111111")
+                                     ("purchases", fc::variants{}) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "receiver account not exists" ),
+                        push_action( "alice1111111"_n, "batchbuygas"_n, mvo()
+                                     ("payer", "alice1111111")
+                                     ("purchases", fc::variants{ purchase("bob111111111", "1.0000"), purchase("nonexistent", "1.0000") }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must purchase a positive amount" ),
+                        push_action( "alice1111111"_n, "batchbuygas"_n, mvo()
+                                     ("payer", "alice1111111")
+                                     ("purchases", fc::variants{ purchase("bob111111111", "1.0000"), purchase("carol1111111", "0.0000") }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must buy gas with core asset" ),
+                        push_action( "alice1111111"_n, "batchbuygas"_n, mvo()
+                                     ("payer", "alice1111111")
+                                     ("purchases", fc::variants{ mvo()("receiver", "bob111111111")("quant", asset::from_string("1.0000 OTHER")) }) ) );
+
+   // known gas quotas before the purchase
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setalimits"_n, mvo()
+                                                ("account", "bob111111111")("gas", 1000)("is_unlimited", false) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( config::system_account_name, "setalimits"_n, mvo()
+                                                ("account", "carol1111111")("gas", 2000)("is_unlimited", false) ) );
+
+   const asset alice_balance = get_balance( "alice1111111" );
+   const asset gas_balance   = get_balance( "flon.gas" );
+   auto trace = base_tester::push_action( config::system_account_name, "batchbuygas"_n,
+                                          vector<account_name>{ "alice1111111"_n, "flon.gas"_n }, mvo()
+                                          ("payer", "alice1111111")
+                                          ("purchases", fc::variants{ purchase("bob111111111", "1.0000"),
+                                                                      purchase("carol1111111", "2.0000"),
+                                                                      purchase("bob111111111", "0.5000") }) );
+   BOOST_REQUIRE( trace->receipt.has_value() );
+
+   // a single transfer of the total, whatever the number of receivers
+   const auto transfers = std::count_if( trace->action_traces.begin(), trace->action_traces.end(), []( const auto& at ) {
+      return at.receiver == "flon.token"_n && at.act.name == "transfer"_n;
+   });
+   BOOST_REQUIRE_EQUAL( 1, transfers );
+   BOOST_REQUIRE_EQUAL( alice_balance - core_sym::from_string("3.5000"), get_balance( "alice1111111" ) );
+   BOOST_REQUIRE_EQUAL( gas_balance + core_sym::from_string("3.5000"), get_balance( "flon.gas" ) );
+
+   // each receiver's quota is raised by its own quantities, setalimits reads it back through get_resource_limits
+   const auto gas_unchanged = [&]( const string& account, uint64_t gas ) {
+      return push_action( config::system_account_name, "setalimits"_n, mvo()
+                          ("account", account)("gas", gas)("is_unlimited", false) );
+   };
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "data does not have change" ),
+                        gas_unchanged( "bob111111111", 1000 + core_sym::from_string("1.5000").get_amount() ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "data does not have change" ),
+                        gas_unchanged( "carol1111111", 2000 + core_sym::from_string("2.0000").get_amount() ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( batch_set_account_limits, eosio_system_tester ) try {
+   auto limits = []( const string& account, uint64_t gas, bool is_unlimited ) {
+      return mvo()("account", account)("gas", gas)("is_unlimited", is_unlimited);
+   };
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of flon" ),
+                        push_action( "alice1111111"_n, "batchalimits"_n, mvo()
+                                     ("limits", fc::variants{ limits("alice1111111", 1000, false) }) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "limits cannot be empty" ),
+                        push_action( config::system_account_name, "batchalimits"_n, mvo()
+                                     ("limits", fc::variants{}) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account not exists" ),
+                        push_action( config::system_account_name, "batchalimits"_n, mvo()
+                                     ("limits", fc::variants{ limits("alice1111111", 1000, false), limits("nonexistent", 1000, false) }) ) );
+
+   BOOST_REQUIRE_EQUAL( success(),
+                        push_action( config::system_account_name, "batchalimits"_n, mvo()
+                                     ("limits", fc::variants{ limits("alice1111111", 1000, false), limits("bob111111111", 2000, false) }) ) );
+
+   // every entry was applied, setting the same limits again has no change
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "data does not have change" ),
+                        push_action( config::system_account_name, "setalimits"_n, mvo()
+                                     ("account", "alice1111111")("gas", 1000)("is_unlimited", false) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "data does not have change" ),
+                        push_action( config::system_account_name, "setalimits"_n, mvo()
+                                     ("account", "bob111111111")("gas", 2000)("is_unlimited", false) ) );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -98,6 +98,113 @@ public:
       );
    }
 
+   action_result transfers( account_name from,
+                            const vector<std::tuple<account_name, asset, string>>& items ) {
+      fc::variants transfer_items;
+      for( const auto& [to, quantity, memo] : items ) {
+         transfer_items.push_back( mvo()( "to", to )( "quantity", quantity )( "memo", memo ) );
+      }
+      return push_action( from, "transfers"_n, mvo()
+           ( "from", from)
+           ( "transfers", transfer_items)
+      );
+   }
+
+   // Pushes a read-only action and unpacks its return value
+   fc::variant read_only_action( const action_name& name, const variant_object& data ) {
+      return eosio::testing::read_only_action( *this, "flon.token"_n, abi_ser, name, data );
+   }
+
+   using recipient_page = vector<std::pair<account_name, asset>>;
+
+   // The hash of a distribution page, sha256(to || amount || ... || next_hash)
+   static fc::sha256 page_hash( const recipient_page& page, const fc::sha256& next_hash ) {
+      vector<char> data;
+      for( const auto& [to, quantity] : page ) {
+         const uint64_t to_value = to.to_uint64_t();
+         const int64_t amount = quantity.get_amount();
+         data.insert( data.end(), reinterpret_cast<const char*>(&to_value), reinterpret_cast<const char*>(&to_value) + sizeof(to_value) );
+         data.insert( data.end(), reinterpret_cast<const char*>(&amount), reinterpret_cast<const char*>(&amount) + sizeof(amount) );
+      }
+      data.insert( data.end(), next_hash.data(), next_hash.data() + 32 );
+      return fc::sha256::hash( data.data(), data.size() );
+   }
+
+   // The hash of each page, built backwards from the last one, the first one is the recipients hash
+   static vector<fc::sha256> page_hashes( const vector<recipient_page>& pages ) {
+      vector<fc::sha256> hashes( pages.size() + 1 );
+      for( size_t i = pages.size(); i > 0; --i ) {
+         hashes[i - 1] = page_hash( pages[i - 1], hashes[i] );
+      }
+      return hashes;
+   }
+
+   action_result regdist( account_name issuer, asset total, const fc::sha256& hash ) {
+      return push_action( issuer, "regdist"_n, mvo()
+           ( "issuer", issuer )
+           ( "total", total )
+           ( "recipients_hash", hash )
+      );
+   }
+
+   transaction_trace_ptr push_distribute( account_name issuer, uint64_t dist_id, const recipient_page& recipients, const fc::sha256& next_hash ) {
+      fc::variants items;
+      for( const auto& [to, quantity] : recipients ) {
+         items.push_back( mvo()( "to", to )( "quantity", quantity ) );
+      }
+      return base_tester::push_action( "flon.token"_n, "distribute"_n, issuer, mvo()
+           ( "dist_id", dist_id )
+           ( "recipients", items )
+           ( "next_hash", next_hash )
+      );
+   }
+
+   action_result distribute( account_name issuer, uint64_t dist_id, const recipient_page& recipients, const fc::sha256& next_hash ) {
+      try {
+         push_distribute( issuer, dist_id, recipients, next_hash );
+      } catch( const fc::exception& ex ) {
+         return error( ex.top_message() );
+      }
+      return success();
+   }
+
+   action_result canceldist( account_name issuer, uint64_t dist_id ) {
+      return push_action( issuer, "canceldist"_n, mvo()( "dist_id", dist_id ) );
+   }
+
+   fc::variant get_distribution( uint64_t dist_id ) {
+      vector<char> data = get_row_by_account( "flon.token"_n, "flon.token"_n, "dists"_n, account_name(dist_id) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "distribution", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   // Distributes `count` recipients cycling over `accounts` in pages of `page_size`, returns the total cpu time in us
+   int64_t benchmark_distribution( account_name issuer, const vector<account_name>& accounts, uint32_t count, uint32_t page_size ) {
+      const asset unit = asset::from_string("1 CERO");
+      vector<recipient_page> pages;
+      for( uint32_t i = 0; i < count; ++i ) {
+         if( i % page_size == 0 ) {
+            pages.emplace_back();
+            pages.back().reserve( page_size );
+         }
+         pages.back().emplace_back( accounts[i % accounts.size()], unit );
+      }
+      const auto hashes = page_hashes( pages );
+
+      const uint64_t dist_id = 0;
+      BOOST_REQUIRE_EQUAL( success(), regdist( issuer, asset( count, unit.get_symbol() ), hashes[0] ) );
+
+      int64_t cpu_us = 0;
+      for( size_t i = 0; i < pages.size(); ++i ) {
+         auto trace = push_distribute( issuer, dist_id, pages[i], hashes[i + 1] );
+         cpu_us += trace->receipt->cpu_usage_us;
+         if( i % 50 == 49 ) {
+            produce_block();
+         }
+      }
+      BOOST_REQUIRE( get_distribution( dist_id ).is_null() );
+      return cpu_us;
+   }
+
    action_result open( account_name owner,
                        const string& symbolname,
                        account_name ram_payer    ) {
@@ -343,6 +450,194 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( transfers_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   produce_blocks(1);
+
+   issue( "alice"_n, asset::from_string("1000 CERO"), "hola" );
+
+   BOOST_REQUIRE_EQUAL( success(), transfers( "alice"_n, {
+      { "bob"_n,   asset::from_string("300 CERO"), "hola" },
+      { "carol"_n, asset::from_string("200 CERO"), "hola" },
+      { "bob"_n,   asset::from_string("100 CERO"), "" }
+   } ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("carol"_n, "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+
+   // the sender is debited once for the sum of the batch
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+      transfers( "alice"_n, {
+         { "bob"_n,   asset::from_string("300 CERO"), "hola" },
+         { "carol"_n, asset::from_string("101 CERO"), "hola" }
+      } )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+      transfers( "alice"_n, { { "alice"_n, asset::from_string("1 CERO"), "hola" } } )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must transfer positive quantity" ),
+      transfers( "alice"_n, {
+         { "bob"_n,   asset::from_string("1 CERO"), "hola" },
+         { "carol"_n, asset::from_string("-1 CERO"), "hola" }
+      } )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "to account does not exist" ),
+      transfers( "alice"_n, { { "dave"_n, asset::from_string("1 CERO"), "hola" } } )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no transfers" ), transfers( "alice"_n, {} ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( read_only_query_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   create( "bob"_n, asset::from_string("100.000 TKN"));
+   produce_blocks(1);
+
+   issue( "alice"_n, asset::from_string("1000 CERO"), "hola" );
+   issue( "bob"_n, asset::from_string("40.000 TKN"), "hola" );
+   transfer( "alice"_n, "bob"_n, asset::from_string("300 CERO"), "hola" );
+
+   auto balances = read_only_action( "getbalances"_n, mvo()
+      ( "owners", vector<account_name>{ "alice"_n, "bob"_n, "carol"_n } )
+      ( "sym_code", "CERO" )
+   ).as<vector<asset>>();
+   BOOST_REQUIRE_EQUAL( 3u, balances.size() );
+   BOOST_REQUIRE_EQUAL( asset::from_string("700 CERO"), balances[0] );
+   BOOST_REQUIRE_EQUAL( asset::from_string("300 CERO"), balances[1] );
+   BOOST_REQUIRE_EQUAL( asset::from_string("0 CERO"), balances[2] );
+
+   auto supplies = read_only_action( "getsupplies"_n, mvo()
+      ( "sym_codes", vector<string>{ "TKN", "CERO" } )
+   ).as<vector<asset>>();
+   BOOST_REQUIRE_EQUAL( 2u, supplies.size() );
+   BOOST_REQUIRE_EQUAL( asset::from_string("40.000 TKN"), supplies[0] );
+   BOOST_REQUIRE_EQUAL( asset::from_string("1000 CERO"), supplies[1] );
+
+   BOOST_REQUIRE_EXCEPTION( read_only_action( "getsupplies"_n, mvo()( "sym_codes", vector<string>{ "NONE" } ) ),
+                            eosio_assert_message_exception, eosio_assert_message_is("invalid supply symbol code") );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( distribution_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   produce_blocks(1);
+
+   const vector<recipient_page> pages = {
+      { { "bob"_n,   asset::from_string("300 CERO") } },
+      { { "carol"_n, asset::from_string("200 CERO") },
+        { "bob"_n,   asset::from_string("100 CERO") } }
+   };
+   const auto hashes = page_hashes( pages );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "only the issuer can register a distribution" ),
+      regdist( "bob"_n, asset::from_string("600 CERO"), hashes[0] )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "quantity exceeds available supply" ),
+      regdist( "alice"_n, asset::from_string("1001 CERO"), hashes[0] )
+   );
+
+   // the total is issued at registration
+   BOOST_REQUIRE_EQUAL( success(), regdist( "alice"_n, asset::from_string("600 CERO"), hashes[0] ) );
+   BOOST_REQUIRE_EQUAL( "600 CERO", get_stats("0,CERO")["supply"].as_string() );
+
+   // a page not matching the commitment is rejected before anything is credited
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "recipients do not match the distribution hash" ),
+      distribute( "alice"_n, 0, { { "carol"_n, asset::from_string("300 CERO") } }, hashes[1] )
+   );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "recipients do not match the distribution hash" ),
+      distribute( "alice"_n, 0, pages[0], fc::sha256() )
+   );
+   BOOST_REQUIRE( get_account("carol"_n, "0,CERO").is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), distribute( "alice"_n, 0, pages[0], hashes[1] ) );
+   auto dist = get_distribution( 0 );
+   BOOST_REQUIRE_EQUAL( 1u, dist["cursor"].as_uint64() );
+   BOOST_REQUIRE_EQUAL( "300 CERO", dist["distributed"].as_string() );
+   BOOST_REQUIRE_EQUAL( hashes[1], dist["cursor_hash"].as<fc::sha256>() );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "300 CERO")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "recipients exceed distribution total" ),
+      distribute( "alice"_n, 0, { { "carol"_n, asset::from_string("301 CERO") } }, fc::sha256() )
+   );
+   // the first page can not be credited twice
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "recipients do not match the distribution hash" ),
+      distribute( "alice"_n, 0, pages[0], hashes[1] )
+   );
+
+   BOOST_REQUIRE_EQUAL( success(), distribute( "alice"_n, 0, pages[1], hashes[2] ) );
+   BOOST_REQUIRE( get_distribution( 0 ).is_null() );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "400 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("carol"_n, "0,CERO"), mvo()
+      ("balance", "200 CERO")
+   );
+
+   // a commitment whose last page does not complete the total can only be canceled
+   const vector<recipient_page> short_pages = { { { "carol"_n, asset::from_string("100 CERO") } } };
+   BOOST_REQUIRE_EQUAL( success(), regdist( "alice"_n, asset::from_string("400 CERO"), page_hashes( short_pages )[0] ) );
+   BOOST_REQUIRE_EQUAL( "1000 CERO", get_stats("0,CERO")["supply"].as_string() );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "last page does not complete the distribution total" ),
+      distribute( "alice"_n, 0, short_pages[0], fc::sha256() )
+   );
+
+   // canceling retires what was not credited
+   const vector<recipient_page> cancel_pages = {
+      { { "carol"_n, asset::from_string("100 CERO") } },
+      { { "bob"_n,   asset::from_string("300 CERO") } }
+   };
+   const auto cancel_hashes = page_hashes( cancel_pages );
+   BOOST_REQUIRE_EQUAL( success(), canceldist( "alice"_n, 0 ) );
+   BOOST_REQUIRE_EQUAL( "600 CERO", get_stats("0,CERO")["supply"].as_string() );
+   BOOST_REQUIRE_EQUAL( success(), regdist( "alice"_n, asset::from_string("400 CERO"), cancel_hashes[0] ) );
+   BOOST_REQUIRE_EQUAL( success(), distribute( "alice"_n, 0, cancel_pages[0], cancel_hashes[1] ) );
+   BOOST_REQUIRE_EQUAL( success(), canceldist( "alice"_n, 0 ) );
+   BOOST_REQUIRE( get_distribution( 0 ).is_null() );
+   BOOST_REQUIRE_EQUAL( "700 CERO", get_stats("0,CERO")["supply"].as_string() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( distribution_benchmark, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000000 CERO"));
+   produce_blocks(1);
+
+   vector<account_name> accounts;
+   for( uint32_t i = 0; i < 1000; ++i ) {
+      accounts.emplace_back( std::string("rcpt") + char('a' + i / 676) + char('a' + i / 26 % 26) + char('a' + i % 26) );
+   }
+   create_accounts( accounts );
+   produce_blocks(1);
+
+   const uint32_t page_size = 200;
+   for( const uint32_t count : { 10'000u, 100'000u } ) {
+      const auto cpu_us = benchmark_distribution( "alice"_n, accounts, count, page_size );
+      BOOST_TEST_MESSAGE( "distribution of " << count << " recipients in pages of " << page_size << ": "
+                          << cpu_us << " us cpu, " << double(cpu_us) / count << " us per recipient" );
+   }
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE( open_tests, eosio_token_tester ) try {
 
    auto token = create( "alice"_n, asset::from_string("1000 CERO"));
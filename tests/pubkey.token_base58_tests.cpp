@@ -0,0 +1,140 @@
+#include <boost/test/unit_test.hpp>
+#include <fc/crypto/ripemd160.hpp>
+#include <fc/time.hpp>
+
+#include "../contracts/pubkey.token/include/base58.hpp"
+
+#include <random>
+#include <string>
+
+namespace {
+
+   // Encodes big endian `data` in base58, the inverse of DecodeBase58
+   std::string encode_base58( const std::vector<unsigned char>& data ) {
+      size_t zeroes = 0;
+      while( zeroes < data.size() && data[zeroes] == 0 ) {
+         ++zeroes;
+      }
+      std::vector<unsigned char> b58( (data.size() - zeroes) * 138 / 100 + 1 );
+      size_t length = 0;
+      for( size_t i = zeroes; i < data.size(); ++i ) {
+         int carry = data[i];
+         size_t j = 0;
+         for( auto it = b58.rbegin(); (carry != 0 || j < length) && it != b58.rend(); ++it, ++j ) {
+            carry += 256 * (*it);
+            *it = carry % 58;
+            carry /= 58;
+         }
+         length = j;
+      }
+      auto it = b58.begin() + (b58.size() - length);
+      while( it != b58.end() && *it == 0 ) {
+         ++it;
+      }
+      std::string str( zeroes, '1' );
+      for( ; it != b58.end(); ++it ) {
+         str += pszBase58[*it];
+      }
+      return str;
+   }
+
+   // The reference decoder restricted to 37 bytes, as pubkey.token used it
+   bool reference_decode( const std::string& str, std::array<unsigned char, 37>& out ) {
+      std::vector<unsigned char> vch;
+      if( !DecodeBase58( str.c_str(), vch ) || vch.size() != out.size() ) {
+         return false;
+      }
+      std::copy( vch.begin(), vch.end(), out.begin() );
+      return true;
+   }
+
+}
+
+BOOST_AUTO_TEST_SUITE(pubkey_token_base58_tests)
+
+BOOST_AUTO_TEST_CASE( decode_public_key ) try {
+   const std::string key = "6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV";
+
+   std::array<unsigned char, 37> data;
+   BOOST_REQUIRE( decode_base58_fixed( key, data ) );
+
+   // the last 4 bytes are the legacy checksum of the key
+   const auto digest = fc::ripemd160::hash( reinterpret_cast<const char*>(data.data()), 33 );
+   BOOST_REQUIRE( memcmp( digest.data(), data.data() + 33, 4 ) == 0 );
+
+   std::array<unsigned char, 37> expected;
+   BOOST_REQUIRE( reference_decode( key, expected ) );
+   BOOST_REQUIRE( data == expected );
+
+   BOOST_REQUIRE( !decode_base58_fixed( key.substr( 1 ), data ) );
+   BOOST_REQUIRE( !decode_base58_fixed( key + "1", data ) );
+   BOOST_REQUIRE( !decode_base58_fixed( key.substr( 0, 10 ) + "0" + key.substr( 11 ), data ) );
+   BOOST_REQUIRE( decode_base58_fixed( " " + key + " ", data ) );
+   BOOST_REQUIRE( data == expected );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( fuzz_equivalence ) try {
+   std::mt19937 rng( 58 );
+
+   // round trips of encoded 37-byte values, with and without leading zero bytes
+   for( uint32_t n = 0; n < 20000; ++n ) {
+      std::vector<unsigned char> value( 37 );
+      const size_t leading_zeroes = rng() % 4 == 0 ? rng() % 38 : 0;
+      for( size_t i = leading_zeroes; i < value.size(); ++i ) {
+         value[i] = rng();
+      }
+      const auto str = encode_base58( value );
+
+      std::array<unsigned char, 37> data;
+      BOOST_REQUIRE( decode_base58_fixed( str, data ) );
+      BOOST_REQUIRE( std::equal( value.begin(), value.end(), data.begin() ) );
+   }
+
+   // arbitrary strings decode the same as the reference decoder
+   const std::string charset = std::string( pszBase58 ) + "0OIl +/ \t";
+   for( uint32_t n = 0; n < 200000; ++n ) {
+      std::string str( rng() % 56, ' ' );
+      const bool base58_only = rng() % 2 == 0;
+      for( auto& c : str ) {
+         c = base58_only ? pszBase58[rng() % 58] : charset[rng() % charset.size()];
+      }
+      if( rng() % 8 == 0 ) {
+         str = std::string( rng() % 5, '1' ) + str;
+      }
+
+      std::array<unsigned char, 37> expected, data;
+      const bool expected_ok = reference_decode( str, expected );
+      BOOST_REQUIRE_EQUAL( expected_ok, decode_base58_fixed( str, data ) );
+      if( expected_ok ) {
+         BOOST_REQUIRE( data == expected );
+      }
+   }
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( decode_benchmark ) try {
+   const std::string key = "6MRyAjQq8ud7hVNYcfnVPJqcVpscN5So8BhtHuGYqET5GDW5CV";
+   const uint32_t rounds = 100000;
+   uint32_t checksum = 0;
+
+   auto start = fc::time_point::now();
+   for( uint32_t n = 0; n < rounds; ++n ) {
+      std::array<unsigned char, 37> data;
+      reference_decode( key, data );
+      checksum += data[n % data.size()];
+   }
+   const auto reference_us = (fc::time_point::now() - start).count();
+
+   start = fc::time_point::now();
+   for( uint32_t n = 0; n < rounds; ++n ) {
+      std::array<unsigned char, 37> data;
+      decode_base58_fixed( key, data );
+      checksum -= data[n % data.size()];
+   }
+   const auto fixed_us = (fc::time_point::now() - start).count();
+
+   BOOST_REQUIRE_EQUAL( 0u, checksum );
+   BOOST_TEST_MESSAGE( "base58 public key decode: reference " << double(reference_us) * 1000 / rounds
+                       << " ns, fixed size " << double(fixed_us) * 1000 / rounds << " ns" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,232 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <fc/crypto/base58.hpp>
+#include <fc/crypto/ripemd160.hpp>
+#include "flon.system_tester.hpp"
+
+#include <fc/variant_object.hpp>
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace fc;
+using namespace std;
+
+using mvo = fc::mutable_variant_object;
+
+class pubkey_token_tester : public eosio_system::base_system_tester {
+public:
+   static constexpr name pubkey_account = "pubkey.token"_n;
+   static constexpr name token_account  = "flon.token"_n;
+   static constexpr name system_proxy   = "flonian"_n;   // FLON_SYSTEM of pubkey.token
+   static constexpr name miner          = "miner"_n;
+
+   pubkey_token_tester() {
+      produce_blocks( 2 );
+
+      create_accounts( { token_account, pubkey_account, system_proxy, miner, "alice"_n, "bob"_n } );
+      produce_blocks( 2 );
+
+      set_code( token_account, contracts::token_wasm() );
+      set_abi( token_account, contracts::token_abi().data() );
+      set_code( pubkey_account, contracts::pubkey_wasm() );
+      set_abi( pubkey_account, contracts::pubkey_abi().data() );
+      set_code( system_proxy, system_contracts::testing::test_contracts::system_proxy_wasm() );
+      set_abi( system_proxy, system_contracts::testing::test_contracts::system_proxy_abi().data() );
+      set_code_permission( pubkey_account );
+      set_code_permission( system_proxy );
+      produce_blocks();
+
+      const auto& accnt = control->db().get<account_object,by_name>( pubkey_account );
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+
+      base_tester::push_action( token_account, "create"_n, token_account, mvo()
+         ("issuer", token_account)("maximum_supply", asset::from_string("1000000.0000 FLON")) );
+      base_tester::push_action( token_account, "issue"_n, token_account, mvo()
+         ("to", token_account)("quantity", asset::from_string("1000000.0000 FLON"))("memo", "") );
+      token_transfer( token_account, "alice"_n, asset::from_string("1000.0000 FLON"), "" );
+   }
+
+   void set_code_permission( const name& account ) {
+      set_authority( account, config::active_name,
+                     authority( 1, { key_weight{ get_public_key( account, "active" ), 1 } },
+                                { permission_level_weight{ { account, config::eosio_code_name }, 1 } } ),
+                     config::owner_name );
+   }
+
+   transaction_trace_ptr token_transfer( const name& from, const name& to, const asset& quantity, const string& memo ) {
+      return base_tester::push_action( token_account, "transfer"_n, from, mvo()
+         ("from", from)("to", to)("quantity", quantity)("memo", memo) );
+   }
+
+   asset get_flon_balance( const name& account ) {
+      return get_currency_balance( token_account, symbol::from_string("4,FLON"), account );
+   }
+
+   // A deposit memo for `key` in the FU format: the key and the first 4 bytes of its ripemd160, in base58
+   static string pubkey_memo( const public_key_type& key ) {
+      const auto packed = fc::raw::pack( key );
+      vector<char> data( packed.begin() + 1, packed.end() ); // skips the key type
+      const auto digest = fc::ripemd160::hash( data.data(), data.size() );
+      data.insert( data.end(), digest.data(), digest.data() + 4 );
+      return "FU" + fc::to_base58( data.data(), data.size(), fc::yield_function_t() );
+   }
+
+   // Keys held by the users of pubkey.token
+   static public_key_type user_key( const string& role ) { return get_public_key( "pubkeyuser"_n, role ); }
+
+   void deposit( const string& role, const asset& quantity ) {
+      token_transfer( "alice"_n, pubkey_account, quantity, pubkey_memo( user_key( role ) ) );
+   }
+
+   fc::variant get_pubkey_account( uint64_t id ) {
+      vector<char> data = get_row_by_id( pubkey_account, pubkey_account, "pubkeyaccts"_n, id );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "pubkey_account_t", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant newaccount_entry( const string& role, const name& acct ) {
+      const auto sig = get_private_key( "pubkeyuser"_n, role ).sign( fc::sha256::hash( acct.to_string() ) );
+      return mvo()("pubkey", user_key( role ))("acct", acct)("sig", sig);
+   }
+
+   fc::variant move_entry( const string& role, uint64_t id, const name& to_acct ) {
+      const auto last_recv_at = get_pubkey_account( id )["last_recv_at"].as<fc::time_point>();
+      const auto digest = fc::sha256::hash( std::to_string( last_recv_at.time_since_epoch().count() ) );
+      return mvo()("pubkey", user_key( role ))("last_recv_at", last_recv_at)("to_acct", to_acct)
+                  ("sig", get_private_key( "pubkeyuser"_n, role ).sign( digest ));
+   }
+
+   // The flon.token actions sent by the pubkey.token action of `trace`
+   static vector<action_name> token_actions( const transaction_trace_ptr& trace ) {
+      vector<action_name> actions;
+      for( const auto& a : trace->action_traces ) {
+         if( a.receiver == token_account && a.act.account == token_account ) {
+            actions.push_back( a.act.name );
+         }
+      }
+      return actions;
+   }
+
+   abi_serializer abi_ser;
+};
+
+BOOST_AUTO_TEST_SUITE(pubkey_token_tests)
+
+BOOST_FIXTURE_TEST_CASE( newaccounts_batch, pubkey_token_tester ) try {
+   deposit( "key1", asset::from_string("1.0000 FLON") );
+   deposit( "key2", asset::from_string("2.0000 FLON") );
+   const auto miner_balance = get_flon_balance( miner );
+
+   auto trace = base_tester::push_action( pubkey_account, "newaccounts"_n, miner, mvo()
+      ("miner", miner)
+      ("entries", vector<fc::variant>{ newaccount_entry( "key1", "newaccount11"_n ), newaccount_entry( "key2", "newaccount12"_n ) }) );
+
+   // the fees of both entries and both collections are paid by one transfers action
+   BOOST_REQUIRE( token_actions( trace ) == vector<action_name>{ "transfers"_n } );
+   BOOST_REQUIRE_EQUAL( miner_balance + asset::from_string("0.2000 FLON"), get_flon_balance( miner ) );
+   BOOST_REQUIRE_EQUAL( asset::from_string("0.9000 FLON"), get_flon_balance( "newaccount11"_n ) );
+   BOOST_REQUIRE_EQUAL( asset::from_string("1.9000 FLON"), get_flon_balance( "newaccount12"_n ) );
+   BOOST_REQUIRE_EQUAL( asset::from_string("0.0000 FLON"), get_flon_balance( pubkey_account ) );
+   BOOST_REQUIRE( get_pubkey_account( 1 ).is_null() );
+   BOOST_REQUIRE( get_pubkey_account( 2 ).is_null() );
+
+   // the new accounts are owned by their public keys
+   const auto& perm = control->db().get<permission_object, by_owner>( boost::make_tuple( "newaccount12"_n, config::active_name ) );
+   BOOST_REQUIRE( perm.auth.to_authority() == authority( user_key( "key2" ) ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( moves_batch, pubkey_token_tester ) try {
+   deposit( "key1", asset::from_string("1.0000 FLON") );
+   deposit( "key2", asset::from_string("3.0000 FLON") );
+   const auto entries = vector<fc::variant>{ move_entry( "key1", 1, "alice"_n ), move_entry( "key2", 2, "bob"_n ) };
+
+   // only the miner can submit the batch and be paid its fees
+   BOOST_REQUIRE_EXCEPTION( base_tester::push_action( pubkey_account, "moves"_n, "bob"_n, mvo()("miner", miner)("entries", entries) ),
+                            missing_auth_exception, eosio::testing::fc_exception_message_starts_with( "missing authority of miner" ) );
+
+   const auto miner_balance = get_flon_balance( miner );
+   const auto alice_balance = get_flon_balance( "alice"_n );
+   auto trace = base_tester::push_action( pubkey_account, "moves"_n, miner, mvo()("miner", miner)("entries", entries) );
+
+   // one transfer of the fees, then one transfer per recipient
+   BOOST_REQUIRE( token_actions( trace ) == vector<action_name>( 3, "transfer"_n ) );
+   BOOST_REQUIRE_EQUAL( miner_balance + asset::from_string("0.2000 FLON"), get_flon_balance( miner ) );
+   BOOST_REQUIRE_EQUAL( alice_balance + asset::from_string("0.9000 FLON"), get_flon_balance( "alice"_n ) );
+   BOOST_REQUIRE_EQUAL( asset::from_string("2.9000 FLON"), get_flon_balance( "bob"_n ) );
+   BOOST_REQUIRE( get_pubkey_account( 1 ).is_null() );
+   BOOST_REQUIRE( get_pubkey_account( 2 ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( migrate_legacy_rows, pubkey_token_tester ) try {
+   // rows written before pubkey.token stored the pubkey hash
+   set_code( pubkey_account, system_contracts::testing::test_contracts::legacy_pubkey_wasm() );
+   set_abi( pubkey_account, system_contracts::testing::test_contracts::legacy_pubkey_abi().data() );
+   for( uint64_t i = 0; i < 3; ++i ) {
+      base_tester::push_action( pubkey_account, "setrow"_n, pubkey_account, mvo()
+         ("id", 100 + i)("pubkey", user_key( "legacy" + std::to_string(i) ))("quantity", asset::from_string("1.0000 FLON")) );
+   }
+   set_code( pubkey_account, contracts::pubkey_wasm() );
+   set_abi( pubkey_account, contracts::pubkey_abi().data() );
+   produce_block();
+   BOOST_REQUIRE( !get_pubkey_account( 100 ).get_object().contains( "pubkey_hash" ) );
+
+   // a partial migration, the rows left are still found through by.pubkey
+   base_tester::push_action( pubkey_account, "migrate"_n, pubkey_account, mvo()("from_id", 0)("count", 2) );
+   BOOST_REQUIRE( get_pubkey_account( 100 ).get_object().contains( "pubkey_hash" ) );
+   BOOST_REQUIRE( get_pubkey_account( 101 ).get_object().contains( "pubkey_hash" ) );
+   BOOST_REQUIRE( !get_pubkey_account( 102 ).get_object().contains( "pubkey_hash" ) );
+   base_tester::push_action( pubkey_account, "migrate"_n, pubkey_account, mvo()("from_id", 102)("count", 10) );
+   BOOST_REQUIRE( get_pubkey_account( 102 ).get_object().contains( "pubkey_hash" ) );
+
+   // deposits to a migrated pubkey credit its row instead of adding one
+   deposit( "legacy1", asset::from_string("2.0000 FLON") );
+   BOOST_REQUIRE_EQUAL( asset::from_string("3.0000 FLON"), get_pubkey_account( 101 )["quantity"].as<asset>() );
+   BOOST_REQUIRE( get_pubkey_account( 1 ).is_null() );
+
+   // and its tokens are moved through the same lookup
+   const auto alice_balance = get_flon_balance( "alice"_n );
+   base_tester::push_action( pubkey_account, "moves"_n, miner, mvo()
+      ("miner", miner)("entries", vector<fc::variant>{ move_entry( "legacy1", 101, "alice"_n ) }) );
+   BOOST_REQUIRE_EQUAL( alice_balance + asset::from_string("2.9000 FLON"), get_flon_balance( "alice"_n ) );
+   BOOST_REQUIRE( get_pubkey_account( 101 ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( deposit_by_transfers, pubkey_token_tester ) try {
+   // each item to pubkey.token in a transfers batch is a deposit to the pubkey of its memo
+   base_tester::push_action( token_account, "transfers"_n, "alice"_n, mvo()
+      ("from",      "alice"_n)
+      ("transfers", vector<fc::variant>{
+         mvo()("to", pubkey_account)("quantity", asset::from_string("1.0000 FLON"))("memo", pubkey_memo( user_key( "key1" ) )),
+         mvo()("to", "bob"_n)("quantity", asset::from_string("2.0000 FLON"))("memo", ""),
+         mvo()("to", pubkey_account)("quantity", asset::from_string("3.0000 FLON"))("memo", pubkey_memo( user_key( "key2" ) )) }) );
+
+   BOOST_REQUIRE_EQUAL( asset::from_string("1.0000 FLON"), get_pubkey_account( 1 )["quantity"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( asset::from_string("3.0000 FLON"), get_pubkey_account( 2 )["quantity"].as<asset>() );
+   BOOST_REQUIRE_EQUAL( asset::from_string("4.0000 FLON"), get_flon_balance( pubkey_account ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( move_requires_miner, pubkey_token_tester ) try {
+   deposit( "key1", asset::from_string("1.0000 FLON") );
+   auto entry = move_entry( "key1", 1, "alice"_n );
+   const auto args = mvo()("miner", miner)("pubkey", entry["pubkey"])("last_recv_at", entry["last_recv_at"])
+                          ("to_acct", entry["to_acct"])("sig", entry["sig"]);
+
+   // move is authorized as moves is
+   BOOST_REQUIRE_EXCEPTION( base_tester::push_action( pubkey_account, "move"_n, "bob"_n, args ),
+                            missing_auth_exception, eosio::testing::fc_exception_message_starts_with( "missing authority of miner" ) );
+
+   const auto miner_balance = get_flon_balance( miner );
+   base_tester::push_action( pubkey_account, "move"_n, miner, args );
+   BOOST_REQUIRE_EQUAL( miner_balance + asset::from_string("0.1000 FLON"), get_flon_balance( miner ) );
+   BOOST_REQUIRE( get_pubkey_account( 1 ).is_null() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+namespace eosio::testing {
+
+   // Pushes the read-only action `name` of `account` and unpacks its return value with `abi_ser`
+   inline fc::variant read_only_action( base_tester& t, const chain::account_name& account, const chain::abi_serializer& abi_ser,
+                                        const chain::action_name& name, const fc::variant_object& data ) {
+      const auto yield = chain::abi_serializer::create_yield_function( base_tester::abi_serializer_max_time );
+
+      chain::action act;
+      act.account = account;
+      act.name    = name;
+      act.data    = abi_ser.variant_to_binary( abi_ser.get_action_type(name), data, yield );
+
+      chain::signed_transaction trx;
+      trx.actions.push_back( std::move(act) );
+      t.set_transaction_headers( trx );
+      auto trace = t.push_transaction( trx, fc::time_point::maximum(), base_tester::DEFAULT_BILLED_CPU_TIME_US, false,
+                                       chain::transaction_metadata::trx_type::read_only );
+      return abi_ser.binary_to_variant( abi_ser.get_action_result_type(name), trace->action_traces[0].return_value, yield );
+   }
+
+} // namespace eosio::testing